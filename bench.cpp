@@ -0,0 +1,609 @@
+#include <iostream>
+#include "bstree.h"
+#include "sharded_bstree.h"
+#include "bstree_parallel.h"
+#include "static_bstree.h"
+#include "kdtree.h"
+#include <chrono>    // std::chrono
+#include <cstdlib>   // std::atoi
+#include <random>    // std::mt19937
+#include <vector>    // std::vector
+#include <algorithm> // std::shuffle
+#include <string>    // std::string, std::to_string
+#include <functional> // std::hash
+#include <thread>    // std::thread
+#include <atomic>    // std::atomic
+#include <utility>   // std::integer_sequence
+
+/**
+	@file bench.cpp
+	@brief Benchmark dei metodi di bstree
+
+	Uso: bench.exe [numero di nodi]
+*/
+
+
+/**
+	Comparatore a tre vie tra numeri interi.
+
+	@brief Comparatore a tre vie tra numeri interi.
+*/
+struct compare_int3 {
+	int operator()(int a, int b) const {
+		return (a<b) ? -1 : (b<a);
+	}
+};
+
+/**
+	Comparatore a tre vie lessicografico tra stringhe, senza prefisso.
+
+	@brief Comparatore a tre vie tra stringhe.
+*/
+struct compare_string3 {
+	int operator()(const std::string &a, const std::string &b) const {
+		return a.compare(b);
+	}
+};
+
+typedef bstree<int, compare_int3> bstint;
+
+/**
+	Cronometro che misura i secondi trascorsi dalla costruzione.
+
+	@brief Cronometro.
+*/
+class stopwatch {
+	std::chrono::steady_clock::time_point _start;
+
+public:
+	stopwatch() : _start(std::chrono::steady_clock::now()) {}
+
+	double seconds() const {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+	}
+};
+
+/**
+	Costruisce un albero con i valori pari da 0 a 2*(n-1) inseriti in ordine casuale.
+
+	@param bst albero da riempire
+	@param n numero di nodi
+*/
+void build_random(bstint &bst, unsigned int n) {
+	std::vector<int> v(n);
+	for(unsigned int i = 0; i < n; ++i)
+		v[i] = 2 * i;
+	std::shuffle(v.begin(), v.end(), std::mt19937(42));
+	for(unsigned int i = 0; i < n; ++i)
+		bst.insert(v[i]);
+}
+
+/**
+	Confronta un ciclo di search() con search_batch() su chiavi casuali
+	(circa meta' presenti e meta' assenti).
+
+	@param n numero di nodi dell'albero
+*/
+void bench_search_batch(unsigned int n) {
+	std::cout << "****** search() vs search_batch() su " << n << " nodi ******" << std::endl;
+
+	bstint bst;
+	build_random(bst, n);
+
+	const unsigned int q = 1 << 21;
+	std::vector<int> keys(q);
+	std::mt19937 gen(7);
+	std::uniform_int_distribution<int> dist(0, 2 * n);
+	for(unsigned int i = 0; i < q; ++i)
+		keys[i] = dist(gen);
+
+	bool *out = new bool[q];
+	unsigned int hits = 0;
+
+	stopwatch t1;
+	for(unsigned int i = 0; i < q; ++i)
+		out[i] = bst.search(keys[i]);
+	double single = t1.seconds();
+	for(unsigned int i = 0; i < q; ++i)
+		hits += out[i];
+
+	stopwatch t2;
+	bst.search_batch(&keys[0], q, out);
+	double batch = t2.seconds();
+	for(unsigned int i = 0; i < q; ++i)
+		hits -= out[i];
+
+	delete[] out;
+
+	std::cout << "search():       " << q / single / 1e6 << " Mlookup/s" << std::endl;
+	std::cout << "search_batch(): " << q / batch / 1e6 << " Mlookup/s" << std::endl;
+	std::cout << "speedup:        " << single / batch << "x" << (hits ? " (RISULTATI DIVERSI)" : "") << std::endl;
+}
+
+
+/**
+	Genera n chiavi stringa del tipo indicato: URL, percorsi di file oppure parole casuali.
+
+	@param kind 0 = URL, 1 = percorsi, 2 = parole casuali
+	@param n numero di chiavi
+	@param gen generatore di numeri casuali
+
+	@return chiavi generate (possono contenere duplicati)
+*/
+std::vector<std::string> make_keys(int kind, unsigned int n, std::mt19937 &gen) {
+	static const char *hosts[] = {"www.example.com", "api.example.com", "cdn.example.org", "shop.example.net"};
+	static const char *dirs[] = {"usr", "lib", "share", "include", "local", "src", "home", "var", "log", "bin"};
+	std::uniform_int_distribution<unsigned int> pick(0, 1u << 30);
+
+	std::vector<std::string> keys(n);
+	for(unsigned int i = 0; i < n; ++i) {
+		unsigned int r = pick(gen);
+		std::string k;
+		if(kind == 0) {
+			k = "https://";
+			k += hosts[r % 4];
+			k += "/product/";
+			k += dirs[(r >> 2) % 10];
+			k += "?id=" + std::to_string(r >> 6);
+		}
+		else if(kind == 1) {
+			k = "/";
+			for(int d = 0; d < 3; ++d) {
+				k += dirs[r % 10];
+				k += "/";
+				r /= 10;
+			}
+			k += "file" + std::to_string(r) + ".txt";
+		}
+		else {
+			for(int c = 0; c < 16; ++c)
+				k += static_cast<char>('a' + pick(gen) % 26);
+		}
+		keys[i] = k;
+	}
+	return keys;
+}
+
+/**
+	Misura costruzione e ricerche su un albero di stringhe con il comparatore C.
+
+	@param keys chiavi da inserire
+	@param queries chiavi da cercare
+	@param name nome del comparatore da stampare
+*/
+template <typename C>
+void bench_string_tree(const std::vector<std::string> &keys, const std::vector<std::string> &queries, const char *name) {
+	bstree<std::string, C> bst;
+
+	stopwatch t1;
+	for(unsigned int i = 0; i < keys.size(); ++i)
+		bst.insert(keys[i]);
+	double build = t1.seconds();
+
+	unsigned int hits = 0;
+	stopwatch t2;
+	for(unsigned int i = 0; i < queries.size(); ++i)
+		hits += bst.search(queries[i]);
+	double lookup = t2.seconds();
+
+	std::cout << name << ": costruzione " << build << " s, ricerca "
+	          << queries.size() / lookup / 1e6 << " Mlookup/s (" << hits << " trovate)" << std::endl;
+}
+
+/**
+	Confronta il comparatore lessicografico con string_prefix_compare su chiavi
+	simili a URL, percorsi di file e parole casuali.
+
+	@param n numero di chiavi
+*/
+void bench_string_prefix(unsigned int n) {
+	static const char *kinds[] = {"URL", "percorsi", "parole casuali"};
+
+	for(int kind = 0; kind < 3; ++kind) {
+		std::cout << "****** Chiavi stringa (" << kinds[kind] << ") su " << n << " chiavi ******" << std::endl;
+		std::mt19937 gen(11);
+		std::vector<std::string> keys = make_keys(kind, n, gen);
+		std::vector<std::string> queries = make_keys(kind, n, gen);
+		for(unsigned int i = 0; i < n; i += 2)
+			queries[i] = keys[(i * 7919u) % n];
+
+		bench_string_tree<compare_string3>(keys, queries, "compare()       ");
+		bench_string_tree<string_prefix_compare>(keys, queries, "prefisso uint64 ");
+	}
+}
+
+/**
+	Confronta le ricerche su un albero senza indice laterale e con il filtro di
+	Bloom, con il 70% di ricerche senza successo.
+
+	@param n numero di nodi dell'albero
+*/
+void bench_bloom(unsigned int n) {
+	std::cout << "****** search() senza e con filtro di Bloom su " << n << " nodi (70% assenti) ******" << std::endl;
+
+	bstint bst;
+	build_random(bst, n);
+	bstree<int, compare_int3, void, bstree_bloom_policy<std::hash<int> > > bloom(bst.begin(), bst.end());
+
+	const unsigned int q = 1 << 21;
+	std::vector<int> keys(q);
+	std::mt19937 gen(5);
+	std::uniform_int_distribution<int> dist(0, n - 1);
+	for(unsigned int i = 0; i < q; ++i)
+		keys[i] = 2 * dist(gen) + ((i % 10) < 7);
+
+	unsigned int hits = 0;
+	stopwatch t1;
+	for(unsigned int i = 0; i < q; ++i)
+		hits += bst.search(keys[i]);
+	double plain = t1.seconds();
+
+	stopwatch t2;
+	for(unsigned int i = 0; i < q; ++i)
+		hits -= bloom.search(keys[i]);
+	double filtered = t2.seconds();
+
+	std::cout << "senza filtro: " << q / plain / 1e6 << " Mlookup/s" << std::endl;
+	std::cout << "con filtro:   " << q / filtered / 1e6 << " Mlookup/s" << std::endl;
+	std::cout << "speedup:      " << plain / filtered << "x" << (hits ? " (RISULTATI DIVERSI)" : "") << std::endl;
+}
+
+
+/**
+	Misura insert_batch() e search_batch() di sharded_bstree al variare del
+	numero di shard (un thread per shard).
+
+	@param n numero di nodi
+*/
+void bench_sharded(unsigned int n) {
+	std::cout << "****** sharded_bstree su " << n << " nodi (" << std::thread::hardware_concurrency() << " core) ******" << std::endl;
+
+	std::vector<int> v(n);
+	for(unsigned int i = 0; i < n; ++i)
+		v[i] = 2 * i;
+	std::shuffle(v.begin(), v.end(), std::mt19937(42));
+	std::vector<int> sample(v.begin(), v.begin() + std::min(n, 4096u));
+	bool *out = new bool[n];
+
+	for(unsigned int k = 1; k <= 16; k *= 2) {
+		sharded_bstree<int, compare_int3> sb(k, sample.begin(), sample.end());
+
+		stopwatch t1;
+		sb.insert_batch(v.begin(), v.end());
+		double build = t1.seconds();
+
+		stopwatch t2;
+		sb.search_batch(&v[0], n, out);
+		double lookup = t2.seconds();
+
+		std::cout << k << " shard: insert_batch " << n / build / 1e6 << " Minsert/s, search_batch "
+		          << n / lookup / 1e6 << " Mlookup/s" << std::endl;
+	}
+
+	delete[] out;
+}
+
+
+/**
+	Funtore che conta i valori multipli di 3 con un contatore atomico,
+	equivalente al predicato di printif.
+*/
+struct count_multiple_of_3 {
+	std::atomic<unsigned int> *count;
+
+	void operator()(int v) const {
+		if(v % 3 == 0)
+			count->fetch_add(1, std::memory_order_relaxed);
+	}
+};
+
+/**
+	Funtore che somma i valori dell'albero.
+*/
+struct sum_values {
+	long long operator()(long long a, long long b) const {
+		return a + b;
+	}
+};
+
+/**
+	Misura la visita sequenziale e parallel_for_each/parallel_reduce con 1-32 thread.
+
+	@param n numero di nodi dell'albero
+*/
+void bench_parallel(unsigned int n) {
+	std::cout << "****** Visite parallele su " << n << " nodi (" << std::thread::hardware_concurrency() << " core) ******" << std::endl;
+
+	bstint bst;
+	build_random(bst, n);
+
+	stopwatch t0;
+	long long seq = 0;
+	for(bstint::const_iterator i = bst.begin(), ie = bst.end(); i != ie; ++i)
+		seq += *i;
+	double list = t0.seconds();
+
+	stopwatch t3;
+	long long seq_tree = 0;
+	for(bstint::const_ordered_iterator i = bst.ordered_begin(), ie = bst.ordered_end(); i != ie; ++i)
+		seq_tree += *i;
+	double sequential = t3.seconds();
+	seq -= seq_tree;
+
+	std::cout << "sequenziale (lista):  " << n / list / 1e6 << " Mnodi/s" << std::endl;
+	std::cout << "sequenziale (albero): " << n / sequential / 1e6 << " Mnodi/s" << (seq ? " (RISULTATI DIVERSI)" : "") << std::endl;
+	seq = seq_tree;
+
+	for(unsigned int threads = 1; threads <= 32; threads *= 2) {
+		bstree_thread_pool pool(threads);
+
+		std::atomic<unsigned int> count(0);
+		count_multiple_of_3 pred = { &count };
+		stopwatch t1;
+		parallel_for_each(pool, bst, pred);
+		double for_each = t1.seconds();
+
+		stopwatch t2;
+		long long sum = parallel_reduce(pool, bst, 0LL, sum_values());
+		double reduce = t2.seconds();
+
+		std::cout << threads << " thread: parallel_for_each " << n / for_each / 1e6 << " Mnodi/s, parallel_reduce "
+		          << n / reduce / 1e6 << " Mnodi/s, speedup sulla lista " << list / reduce << "x"
+		          << (sum != seq ? " (RISULTATI DIVERSI)" : "") << std::endl;
+	}
+}
+
+
+/**
+	Insieme statico delle chiavi 3*i, i = 0..N-1, elencate in ordine sparso.
+*/
+template <typename S>
+struct static_keys;
+
+template <int... I>
+struct static_keys<std::integer_sequence<int, I...> > {
+	typedef static_bstree<int, (3 * ((I * 97) % sizeof...(I)))...> type;
+};
+
+/**
+	Confronta le ricerche su un bstree e su static_bstree con le stesse 255 chiavi.
+*/
+void bench_static() {
+	const int n = 255;
+	typedef static_keys<std::make_integer_sequence<int, n> >::type fixed;
+	std::cout << "****** bstree vs static_bstree su " << fixed::size() << " chiavi ******" << std::endl;
+
+	bstint bst;
+	for(int i = 0; i < n; ++i)
+		bst.insert(3 * ((i * 97) % n));
+
+	const unsigned int q = 1 << 23;
+	std::vector<int> keys(q);
+	std::mt19937 gen(3);
+	std::uniform_int_distribution<int> dist(0, 3 * n);
+	for(unsigned int i = 0; i < q; ++i)
+		keys[i] = dist(gen);
+
+	unsigned int hits = 0;
+	stopwatch t1;
+	for(unsigned int i = 0; i < q; ++i)
+		hits += bst.search(keys[i]);
+	double dynamic = t1.seconds();
+
+	stopwatch t2;
+	for(unsigned int i = 0; i < q; ++i)
+		hits -= fixed::search(keys[i]);
+	double fixed_time = t2.seconds();
+
+	std::cout << "bstree:        " << q / dynamic / 1e6 << " Mlookup/s" << std::endl;
+	std::cout << "static_bstree: " << q / fixed_time / 1e6 << " Mlookup/s" << std::endl;
+	std::cout << "speedup:       " << dynamic / fixed_time << "x" << (hits ? " (RISULTATI DIVERSI)" : "") << std::endl;
+}
+
+
+/**
+	Misura ricerche e visita in ordine prima e dopo compact() su un albero
+	i cui nodi sono sparsi nell'heap da allocazioni intercalate.
+
+	@param n numero di nodi dell'albero
+*/
+void bench_compact(unsigned int n) {
+	std::cout << "****** search() e visita in ordine prima e dopo compact() su " << n << " nodi ******" << std::endl;
+
+	std::vector<int> v(n);
+	for(unsigned int i = 0; i < n; ++i)
+		v[i] = 2 * i;
+	std::shuffle(v.begin(), v.end(), std::mt19937(42));
+
+	bstint bst;
+	std::vector<char *> junk;
+	std::mt19937 gen(9);
+	for(unsigned int i = 0; i < n; ++i) {
+		bst.insert(v[i]);
+		junk.push_back(new char[32 + gen() % 256]);
+	}
+	for(unsigned int i = 0; i < junk.size(); ++i)
+		delete[] junk[i];
+
+	const unsigned int q = 1 << 21;
+	std::vector<int> keys(q);
+	std::uniform_int_distribution<int> dist(0, 2 * n);
+	for(unsigned int i = 0; i < q; ++i)
+		keys[i] = dist(gen);
+
+	for(int round = 0; round < 2; ++round) {
+		std::size_t reclaimed = 0;
+		if(round == 1) {
+			stopwatch t0;
+			reclaimed = bst.compact();
+			std::cout << "compact(): " << t0.seconds() << " s, " << reclaimed << " byte liberati (stima)" << std::endl;
+		}
+
+		unsigned int hits = 0;
+		stopwatch t1;
+		for(unsigned int i = 0; i < q; ++i)
+			hits += bst.search(keys[i]);
+		double lookup = t1.seconds();
+
+		long long sum = 0;
+		stopwatch t2;
+		for(bstint::const_ordered_iterator i = bst.ordered_begin(), ie = bst.ordered_end(); i != ie; ++i)
+			sum += *i;
+		double scan = t2.seconds();
+
+		std::cout << (round ? "dopo:  " : "prima: ") << "search " << q / lookup / 1e6 << " Mlookup/s, visita in ordine "
+		          << n / scan / 1e6 << " Mnodi/s (" << hits << ", " << sum << ")" << std::endl;
+	}
+}
+
+
+/**
+	Punto del piano per il benchmark del k-d tree.
+*/
+struct bench_point {
+	int x;
+	int y;
+};
+
+/**
+	Comparatore a tre vie lessicografico tra punti, come compare_point di main.cpp.
+*/
+struct compare_point3 {
+	int operator()(const bench_point &a, const bench_point &b) const {
+		if(a.x != b.x)
+			return (a.x < b.x) ? -1 : 1;
+		return (a.y < b.y) ? -1 : (b.y < a.y);
+	}
+};
+
+/**
+	Funtore delle coordinate di bench_point.
+*/
+struct bench_point_coordinate {
+	int operator()(const bench_point &p, unsigned int axis) const {
+		return axis ? p.y : p.x;
+	}
+};
+
+/**
+	Funtore che conta i punti visitati da range_query.
+*/
+struct count_points {
+	unsigned int *count;
+
+	void operator()(const bench_point &) const {
+		++*count;
+	}
+};
+
+/**
+	Confronta range_query del k-d tree con la scansione completa di un bstree di
+	punti su rettangoli piccoli, e misura nearest().
+
+	@param n numero di punti
+*/
+void bench_kdtree(unsigned int n) {
+	std::cout << "****** Ricerche in rettangoli su " << n << " punti ******" << std::endl;
+
+	std::mt19937 gen(17);
+	std::uniform_int_distribution<int> coord(0, 1 << 20);
+	std::vector<bench_point> pts(n);
+	for(unsigned int i = 0; i < n; ++i) {
+		pts[i].x = coord(gen);
+		pts[i].y = coord(gen);
+	}
+
+	bstree<bench_point, compare_point3> bst(pts.begin(), pts.end());
+	stopwatch t0;
+	kdtree<bench_point, bench_point_coordinate> kd(pts.begin(), pts.end());
+	std::cout << "costruzione k-d tree: " << t0.seconds() << " s" << std::endl;
+
+	const unsigned int q = 1000;
+	const int side = 1 << 12;
+	unsigned int scan_hits = 0, kd_hits = 0;
+
+	stopwatch t1;
+	for(unsigned int i = 0; i < q / 100; ++i) {
+		int x = coord(gen), y = coord(gen);
+		for(bstree<bench_point, compare_point3>::const_iterator it = bst.begin(), ie = bst.end(); it != ie; ++it)
+			scan_hits += (it->x >= x && it->x <= x + side && it->y >= y && it->y <= y + side);
+	}
+	double scan = t1.seconds() / (q / 100);
+
+	count_points counter = { &kd_hits };
+	stopwatch t2;
+	for(unsigned int i = 0; i < q; ++i) {
+		int x = coord(gen), y = coord(gen);
+		kd.range_query(x, y, x + side, y + side, counter);
+	}
+	double range = t2.seconds() / q;
+
+	bench_point center = { 1 << 19, 1 << 19 };
+	stopwatch t3;
+	unsigned int found = 0;
+	for(unsigned int i = 0; i < q; ++i) {
+		center.x = coord(gen);
+		found += kd.nearest(center, 10).size();
+	}
+	double knn = t3.seconds() / q;
+
+	std::cout << "scansione bstree: " << scan * 1e6 << " us/query (" << scan_hits << " punti)" << std::endl;
+	std::cout << "range_query:      " << range * 1e6 << " us/query (" << kd_hits << " punti)" << std::endl;
+	std::cout << "speedup:          " << scan / range << "x" << std::endl;
+	std::cout << "nearest(10):      " << knn * 1e6 << " us/query (" << found << " punti)" << std::endl;
+}
+
+
+/**
+	Confronta la visita in ordine di chiave con successor() (che copia la
+	stringa, ripete la ricerca e termina con un'eccezione) e con ordered_find()/next().
+
+	@param n numero di chiavi
+*/
+void bench_neighbors(unsigned int n) {
+	std::cout << "****** successor() vs next() su " << n << " chiavi stringa ******" << std::endl;
+
+	std::mt19937 gen(23);
+	std::vector<std::string> keys = make_keys(1, n, gen);
+	bstree<std::string, compare_string3> bst(keys.begin(), keys.end());
+
+	std::size_t len1 = 0, len2 = 0;
+	stopwatch t1;
+	std::string k = bst.getMin();
+	try {
+		for(;;) {
+			len1 += k.size();
+			k = bst.successor(k);
+		}
+	}
+	catch(limit_value_exception &e) {
+	}
+	double throwing = t1.seconds();
+
+	stopwatch t2;
+	typedef bstree<std::string, compare_string3>::const_ordered_iterator iter;
+	for(iter it = bst.ordered_find(bst.getMin()), ie = bst.ordered_end(); it != ie; it = bst.next(it))
+		len2 += it->size();
+	double iterating = t2.seconds();
+
+	std::cout << "successor(): " << bst.size() / throwing / 1e6 << " Mpassi/s" << std::endl;
+	std::cout << "next():      " << bst.size() / iterating / 1e6 << " Mpassi/s" << std::endl;
+	std::cout << "speedup:     " << throwing / iterating << "x" << (len1 != len2 ? " (RISULTATI DIVERSI)" : "") << std::endl;
+}
+
+
+int main(int argc, char **argv) {
+	unsigned int n = (argc > 1) ? std::atoi(argv[1]) : (1 << 22);
+
+	bench_search_batch(n);
+	bench_string_prefix(n / 4);
+	bench_bloom(n);
+	bench_sharded(n);
+	bench_parallel(n);
+	bench_static();
+	bench_compact(n);
+	bench_kdtree(n / 4);
+	bench_neighbors(n / 4);
+
+	return 0;
+}
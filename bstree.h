@@ -5,6 +5,14 @@
 #include <iostream>
 #include <iterator> // std::forward_iterator_tag
 #include <cstddef>  // std::ptrdiff_t
+#include <stdexcept> // std::logic_error
+#include <vector>   // std::vector
+#include <utility>  // std::pair, std::declval
+#include <type_traits> // std::conditional, std::is_same
+#include <string>   // std::string
+#include <cstdint>  // std::uint64_t
+#include <functional> // std::less
+#include <new>      // operator new
 
 /**
 	@file bstree.h
@@ -41,45 +49,584 @@ public:
     limit_value_exception() : std::logic_error("Unable to get from a limit value.") {}
 };
 
+
+/**
+	Policy di statistiche disabilitata. Tutti i metodi sono inline e vuoti,
+	quindi il compilatore elimina completamente il codice di conteggio.
+
+	@brief Statistiche disabilitate
+*/
+struct bstree_no_stats {
+	void count_compare() {}
+	void count_visit() {}
+	void count_operation() {}
+	void count_allocation() {}
+	void reset() {}
+
+	unsigned long compares() const { return 0; }
+	unsigned long visits() const { return 0; }
+	unsigned long operations() const { return 0; }
+	unsigned long allocations() const { return 0; }
+};
+
+
+/**
+	Policy di statistiche abilitata. Conta le chiamate al comparatore, i nodi visitati,
+	le operazioni eseguite e le allocazioni.
+
+	@brief Contatori delle statistiche
+*/
+class bstree_stats {
+	unsigned long _compares; // Chiamate al comparatore a tre vie.
+	unsigned long _visits; // Nodi visitati.
+	unsigned long _operations; // Operazioni pubbliche eseguite.
+	unsigned long _allocations; // Nodi allocati.
+
+public:
+	/**
+		Costruttore di default
+	*/
+	bstree_stats() { reset(); }
+
+	void count_compare() { ++_compares; }
+	void count_visit() { ++_visits; }
+	void count_operation() { ++_operations; }
+	void count_allocation() { ++_allocations; }
+
+	/**
+		Azzera tutti i contatori
+	*/
+	void reset() {
+		_compares = _visits = _operations = _allocations = 0;
+	}
+
+	unsigned long compares() const { return _compares; }
+	unsigned long visits() const { return _visits; }
+	unsigned long operations() const { return _operations; }
+	unsigned long allocations() const { return _allocations; }
+};
+
+
+/**
+	Indice laterale disabilitato: ogni valore puo' essere presente e la ricerca
+	scende sempre nell'albero. Tutti i metodi sono inline e vuoti.
+
+	@brief Indice laterale disabilitato
+*/
+struct bstree_no_filter {
+	template <typename T>
+	void insert(const T &) {}
+
+	template <typename T>
+	void erase(const T &) {}
+
+	template <typename T>
+	bool may_contain(const T &) const { return true; }
+
+	bool needs_rebuild(unsigned int) const { return false; }
+	void rebuild(unsigned int) {}
+	void clear() {}
+};
+
+
+/**
+	Filtro di Bloom a blocchi usato come indice laterale dell'albero. Ogni chiave
+	imposta 6 bit in un unico blocco da 512 bit (una linea di cache), quindi una
+	ricerca senza successo viene scartata in O(1) leggendo una sola linea di cache,
+	con circa l'1% di falsi positivi. Il filtro viene ricostruito dall'albero
+	raddoppiando la capacita' quando il numero di chiavi la supera, oppure quando
+	le rimozioni (che un filtro di Bloom non puo' cancellare) superano meta' della capacita'.
+
+	@brief Filtro di Bloom a blocchi
+
+	@param H funtore di hash dei dati (ad esempio std::hash<T>)
+*/
+template <typename H>
+class bstree_bloom_filter {
+	static const unsigned int block_words = 8; // Parole da 64 bit per blocco.
+	static const unsigned int bits_per_key = 10; // Bit del filtro per chiave prevista.
+	static const unsigned int probes = 6; // Bit impostati per chiave.
+
+	std::vector<std::uint64_t> _bits; // Blocchi del filtro.
+	std::uint64_t _blocks; // Numero di blocchi.
+	unsigned int _capacity; // Numero di chiavi previste.
+	unsigned int _erased; // Chiavi rimosse dall'ultima ricostruzione.
+	H _hash; // Funtore di hash.
+
+	/**
+		Rimescola i bit di un hash (finalizzatore di splitmix64), necessario per
+		funtori come std::hash<int> che sono l'identita'.
+	*/
+	static std::uint64_t mix(std::uint64_t h) {
+		h ^= h >> 30;
+		h *= 0xbf58476d1ce4e5b9ULL;
+		h ^= h >> 27;
+		h *= 0x94d049bb133111ebULL;
+		h ^= h >> 31;
+		return h;
+	}
+
+	/**
+		Ritorna il blocco associato a un hash.
+	*/
+	std::size_t block(std::uint64_t h) const {
+		return static_cast<std::size_t>(((h >> 32) * _blocks) >> 32) * block_words;
+	}
+
+public:
+	/**
+		Costruttore di default: filtro vuoto, verra' dimensionato al primo inserimento.
+	*/
+	bstree_bloom_filter() : _blocks(0), _capacity(0), _erased(0) {}
+
+	/**
+		Aggiunge un valore al filtro.
+	*/
+	template <typename T>
+	void insert(const T &v) {
+		if(!_blocks)
+			return;
+		std::uint64_t h = mix(_hash(v));
+		std::uint64_t *b = &_bits[block(h)];
+		std::uint64_t g = h * 0x9e3779b97f4a7c15ULL;
+		for(unsigned int i = 0; i < probes; ++i, g >>= 9)
+			b[(g & 511) >> 6] |= std::uint64_t(1) << (g & 63);
+	}
+
+	/**
+		Registra la rimozione di un valore. I bit restano impostati e vengono
+		ripuliti alla ricostruzione successiva.
+	*/
+	template <typename T>
+	void erase(const T &) {
+		++_erased;
+	}
+
+	/**
+		@return FALSE se il valore non e' sicuramente presente, TRUE se puo' esserlo
+	*/
+	template <typename T>
+	bool may_contain(const T &v) const {
+		if(!_blocks)
+			return true;
+		std::uint64_t h = mix(_hash(v));
+		const std::uint64_t *b = &_bits[block(h)];
+		std::uint64_t g = h * 0x9e3779b97f4a7c15ULL;
+		for(unsigned int i = 0; i < probes; ++i, g >>= 9)
+			if(!(b[(g & 511) >> 6] & (std::uint64_t(1) << (g & 63))))
+				return false;
+		return true;
+	}
+
+	/**
+		@param size numero di chiavi nell'albero
+		@return TRUE se il filtro va ricostruito
+	*/
+	bool needs_rebuild(unsigned int size) const {
+		return (size > _capacity) || (_erased > _capacity / 2);
+	}
+
+	/**
+		Svuota il filtro e lo dimensiona per il doppio delle chiavi indicate.
+		Le chiavi vanno poi reinserite con insert.
+
+		@param size numero di chiavi nell'albero
+	*/
+	void rebuild(unsigned int size) {
+		_capacity = (size < 32) ? 64 : 2 * size;
+		_erased = 0;
+		_blocks = (static_cast<std::uint64_t>(_capacity) * bits_per_key + 511) / 512;
+		_bits.assign(_blocks * block_words, 0);
+	}
+
+	/**
+		Svuota il filtro
+	*/
+	void clear() {
+		_bits.clear();
+		_blocks = 0;
+		_capacity = 0;
+		_erased = 0;
+	}
+};
+
+
+/**
+	Policy di default dell'albero: nessuna statistica.
+	Per personalizzare il comportamento si deriva da questa struct ridefinendo i typedef.
+
+	@brief Policy di default
+*/
+struct bstree_default_policy {
+	typedef bstree_no_stats stats_type; // Tipo dei contatori delle statistiche.
+	static const bool multiset = false; // Se TRUE i valori ripetuti vengono contati nel nodo.
+	static const bool splay = false; // Se TRUE i nodi acceduti vengono portati alla radice.
+	typedef bstree_no_filter filter_type; // Indice laterale per scartare le ricerche senza successo.
+};
+
+
+/**
+	Policy che abilita le statistiche.
+
+	@brief Policy con statistiche
+*/
+struct bstree_stats_policy : bstree_default_policy {
+	typedef bstree_stats stats_type;
+};
+
+
+/**
+	Policy che conta i valori ripetuti (multiset): un inserimento di un valore gia'
+	presente incrementa il contatore del nodo senza allocare un nuovo nodo.
+
+	@brief Policy multiset
+*/
+struct bstree_multiset_policy : bstree_default_policy {
+	static const bool multiset = true;
+};
+
+
+/**
+	Policy con filtro di Bloom a blocchi come indice laterale: le ricerche di
+	valori assenti vengono scartate senza scendere nell'albero.
+
+	@brief Policy con filtro di Bloom
+
+	@param H funtore di hash dei dati (ad esempio std::hash<T>)
+*/
+template <typename H>
+struct bstree_bloom_policy : bstree_default_policy {
+	typedef bstree_bloom_filter<H> filter_type;
+};
+
+
+/**
+	Policy ad albero auto-aggiustante (splay tree): search, successor, predecessor
+	e insert portano il nodo acceduto alla radice con una sequenza di rotazioni,
+	con costo ammortizzato O(log n) e cammini brevi per le chiavi usate spesso.
+	Le rotazioni vengono eseguite solo dalle versioni non const dei metodi: su un
+	albero const (ad esempio condiviso tra piu' lettori) search, successor,
+	predecessor e find non modificano la struttura, come peek.
+
+	@brief Policy splay
+*/
+struct bstree_splay_policy : bstree_default_policy {
+	static const bool splay = true;
+};
+
+
+/**
+	Contatore delle ripetizioni di un nodo quando la policy non e' multiset:
+	non occupa memoria e vale sempre 1.
+
+	@brief Contatore delle ripetizioni disabilitato
+*/
+template <bool Multiset>
+struct bstree_node_count {
+	unsigned int count() const { return 1; }
+	void set_count(unsigned int) {}
+
+	/**
+		@return FALSE, il valore ripetuto viene ignorato
+	*/
+	bool increment() { return false; }
+
+	/**
+		@return 0, il nodo va rimosso
+	*/
+	unsigned int decrement() { return 0; }
+};
+
+
+/**
+	Contatore delle ripetizioni di un nodo per la policy multiset.
+
+	@brief Contatore delle ripetizioni
+*/
+template <>
+struct bstree_node_count<true> {
+	unsigned int _count; // Numero di ripetizioni del valore.
+
+	bstree_node_count() : _count(1) {}
+
+	unsigned int count() const { return _count; }
+	void set_count(unsigned int c) { _count = c; }
+
+	/**
+		@return TRUE, il valore ripetuto e' stato contato
+	*/
+	bool increment() { ++_count; return true; }
+
+	/**
+		@return numero di ripetizioni rimaste
+	*/
+	unsigned int decrement() { return --_count; }
+};
+
+
+/**
+	Prefisso della chiave di un nodo quando il comparatore non lo supporta:
+	non occupa memoria e vale sempre 0.
+
+	@brief Prefisso della chiave disabilitato
+*/
+template <bool Enabled>
+struct bstree_node_prefix {
+	std::uint64_t prefix() const { return 0; }
+	void set_prefix(std::uint64_t) {}
+};
+
+
+/**
+	Prefisso della chiave memorizzato nel nodo, calcolato dal comparatore.
+
+	@brief Prefisso della chiave
+*/
+template <>
+struct bstree_node_prefix<true> {
+	std::uint64_t _prefix; // Prefisso della chiave del nodo.
+
+	std::uint64_t prefix() const { return _prefix; }
+	void set_prefix(std::uint64_t p) { _prefix = p; }
+};
+
+
+/**
+	Istantanea delle statistiche di un albero restituita da bstree::stats().
+
+	@brief Statistiche dell'albero
+*/
+struct bstree_statistics {
+	unsigned long compares; // Chiamate al comparatore a tre vie.
+	unsigned long visits; // Nodi visitati.
+	unsigned long operations; // Operazioni eseguite.
+	unsigned long allocations; // Nodi allocati.
+	unsigned int height; // Altezza dell'albero (0 se vuoto).
+	double average_depth; // Profondita' media dei nodi (radice a profondita' 0).
+	std::vector<unsigned int> depth_histogram; // Numero di nodi per ogni profondita'.
+};
+
+/**
+	Adattatore che ricava un comparatore a tre vie da un funtore di ordinamento (<).
+	Due valori sono equivalenti se nessuno dei due precede l'altro: !(a<b) && !(b<a).
+
+	@brief Comparatore a tre vie derivato da un funtore (<)
+
+	@param T tipo del dato
+	@param C funtore di comparazione (<) di due dati
+*/
+template <typename T, typename C>
+struct three_way_from_less {
+	C less; // Funtore di ordinamento.
+
+	/**
+		@return valore negativo se a precede b, positivo se b precede a, 0 se equivalenti
+	*/
+	int operator()(const T &a, const T &b) const {
+		if(less(a, b))
+			return -1;
+		if(less(b, a))
+			return 1;
+		return 0;
+	}
+};
+
+
+/**
+	Trait che seleziona il comparatore usato dall'albero. Se C ritorna bool viene
+	considerato un funtore (<) e adattato con three_way_from_less, altrimenti viene
+	usato direttamente come comparatore a tre vie (<0, 0, >0).
+
+	@brief Selezione del comparatore a tre vie
+*/
+template <typename T, typename C>
+struct bstree_comparator {
+	typedef decltype(std::declval<const C &>()(std::declval<const T &>(), std::declval<const T &>())) result_type;
+
+	typedef typename std::conditional<std::is_same<result_type, bool>::value,
+		three_way_from_less<T, C>, C>::type type;
+};
+
+
+/**
+	Trait che determina se un comparatore fornisce il prefisso delle chiavi, cioe'
+	una funzione statica prefix(const T&) che ritorna un std::uint64_t tale che
+	prefix(a) < prefix(b) implica a < b. In questo caso i nodi memorizzano il
+	prefisso e la maggior parte dei confronti si riduce a un confronto tra interi.
+
+	@brief Rilevamento del prefisso delle chiavi
+*/
+template <typename T, typename C>
+class bstree_has_prefix {
+	template <typename X>
+	static char test(decltype(X::prefix(std::declval<const T &>())) *);
+
+	template <typename X>
+	static long test(...);
+
+public:
+	static const bool value = (sizeof(test<C>(nullptr)) == 1);
+};
+
+
+/**
+	Funzione che calcola il prefisso di una chiave, 0 se il comparatore non lo supporta.
+
+	@brief Calcolo del prefisso delle chiavi
+*/
+template <typename T, typename C, bool Enabled = bstree_has_prefix<T, C>::value>
+struct bstree_prefix_of {
+	static std::uint64_t get(const T &) { return 0; }
+};
+
+template <typename T, typename C>
+struct bstree_prefix_of<T, C, true> {
+	static std::uint64_t get(const T &v) { return C::prefix(v); }
+};
+
+
+/**
+	Trait che determina se un comparatore con prefisso fornisce anche una funzione
+	statica compare_tail(const T&, const T&), che confronta due chiavi sapendo che
+	i loro prefissi coincidono e puo' quindi saltare i byte gia' confrontati.
+
+	@brief Rilevamento del confronto dopo il prefisso
+*/
+template <typename T, typename C>
+class bstree_has_compare_tail {
+	template <typename X>
+	static char test(decltype(X::compare_tail(std::declval<const T &>(), std::declval<const T &>())) *);
+
+	template <typename X>
+	static long test(...);
+
+public:
+	static const bool value = (sizeof(test<C>(nullptr)) == 1);
+};
+
+
+/**
+	Funzione che confronta due chiavi con lo stesso prefisso: usa compare_tail se
+	il comparatore la fornisce, altrimenti il comparatore a tre vie.
+
+	@brief Confronto a parita' di prefisso
+*/
+template <typename T, typename C, bool Enabled = bstree_has_compare_tail<T, C>::value>
+struct bstree_compare_tail {
+	template <typename F>
+	static int get(const F &conf, const T &a, const T &b) { return conf(a, b); }
+};
+
+template <typename T, typename C>
+struct bstree_compare_tail<T, C, true> {
+	template <typename F>
+	static int get(const F &, const T &a, const T &b) { return C::compare_tail(a, b); }
+};
+
+
+/**
+	Comparatore a tre vie tra stringhe in ordine lessicografico dei byte che
+	fornisce il prefisso delle chiavi: i primi 8 byte della stringa in big-endian
+	(completati con zeri). Con questo comparatore ogni nodo memorizza il prefisso
+	della propria chiave e la stringa viene letta solo quando i prefissi coincidono,
+	a partire dal nono byte. Conviene solo se le chiavi differiscono nei primi 8
+	byte: con un inizio comune (URL, percorsi) i prefissi coincidono quasi sempre e
+	le ricerche non sono piu' veloci del semplice compare.
+
+	@brief Comparatore tra stringhe con prefisso
+*/
+struct string_prefix_compare {
+	int operator()(const std::string &a, const std::string &b) const {
+		return a.compare(b);
+	}
+
+	/**
+		@return i primi 8 byte di s in big-endian
+	*/
+	static std::uint64_t prefix(const std::string &s) {
+		std::uint64_t p = 0;
+		std::size_t n = (s.size() < 8) ? s.size() : 8;
+		for(std::size_t i = 0; i < n; ++i)
+			p |= static_cast<std::uint64_t>(static_cast<unsigned char>(s[i])) << (56 - 8 * i);
+		return p;
+	}
+
+	/**
+		Confronta due stringhe con lo stesso prefisso saltando i primi 8 byte, gia'
+		uguali. Le stringhe piu' corte di 9 byte vengono confrontate per intero,
+		perche' il prefisso completato con zeri non distingue "a" da "a\0".
+
+		@return valore negativo, nullo o positivo come std::string::compare
+	*/
+	static int compare_tail(const std::string &a, const std::string &b) {
+		if(a.size() <= 8 || b.size() <= 8)
+			return a.compare(b);
+		return a.compare(8, std::string::npos, b, 8, std::string::npos);
+	}
+};
+
+
 /**
 	Classe che implementa un albero binario di ricerca di dati generici T. 
 	L'oridnamento e' effettuati utilizzando un funtore di comparazione C.
-	Di default il funtore usa l'orinamento naturale dei dati indotto dagli operatori di confronto standard.
+	C puo' essere un comparatore a tre vie (ritorna un int <0, 0, >0), che costa una sola
+	chiamata per nodo visitato, oppure un funtore (<) che ritorna bool: in questo caso
+	l'uguaglianza e' l'equivalenza !(a<b) && !(b<a).
 
 	@brief Albero binario di ricerca
 
 	@param T tipo del dato
 	@param C funtore di comparazione (<) di due dati
-	@param E funtore di comparazione (==) di due dati
+	@param E non piu' usato, mantenuto per compatibilita' (l'uguaglianza e' definita da C)
+	@param P policy dell'albero (vedi bstree_default_policy)
 */
 
-template <typename T, typename C, typename E>
+template <typename T, typename C, typename E = void, typename P = bstree_default_policy>
 class bstree {
 
+	// Classe friend che riusa i nodi dell'albero per memorizzare coppie chiave/valore.
+	template <typename K, typename V, typename KC, typename KP>
+	friend class bstree_map;
+
+	// Visite parallele che scendono direttamente nei sottoalberi (vedi bstree_parallel.h).
+	template <typename B>
+	friend struct bstree_parallel;
+
+	struct emplace_tag {}; // Tag per il costruttore del nodo che costruisce il valore sul posto.
+
 	/**
 		Struttura di supporto interna che implementa un nodo dell'albero.
 
 		@brief Nodo dell'albero.
 	*/
     
-    struct node{
+    struct node : bstree_node_count<P::multiset>, bstree_node_prefix<bstree_has_prefix<T, C>::value> {
         T value;
         node *left; // puntatore al nodo sinistro dell'albero.
         node *right; // puntatore al nodo destro dell'albero.
         node *p; // puntatore al nodo genitore dell'albero.
         node *next; // puntatore al nodo successivo dell'albero. Per successivivo si intende per ordine d'inserimento.
+        node *prev; // puntatore al nodo precedente per ordine d'inserimento.
         
 		/**
 			Costruttore di default.
 		*/
-        node() : left(nullptr), right(nullptr), p(nullptr), next(nullptr){ } 
+        node() : left(nullptr), right(nullptr), p(nullptr), next(nullptr), prev(nullptr){ } 
         
 		/**
 			Costruttore secondario che inizializza il nodo.
 			@param v valore del dato
 		*/
 		node(const T &v) 
-			: value(v) , left(nullptr), right(nullptr), p(nullptr), next(nullptr) { } 
+			: value(v) , left(nullptr), right(nullptr), p(nullptr), next(nullptr), prev(nullptr) { } 
+
+		/**
+			Costruttore che costruisce il valore sul posto a partire dai parametri.
+			@param args parametri del costruttore di T
+		*/
+		template <typename... Args>
+		node(emplace_tag, Args&&... args)
+			: value(std::forward<Args>(args)...), left(nullptr), right(nullptr), p(nullptr), next(nullptr), prev(nullptr) { }
         
 		
 
@@ -91,22 +638,94 @@ class bstree {
             right = nullptr;
             p = nullptr;
             next = nullptr;
+            prev = nullptr;
         }
     }; // struct nodo
 
 
 	node *_root; // Puntatore alla radice dell'albero.
+	node *_head; // Puntatore al primo nodo in ordine d'inserimento.
+	node *_tail; // Puntatore all'ultimo nodo in ordine d'inserimento.
 	unsigned int _size;	// Numero di nodi nell'albero.
+	node *_block; // Blocco contiguo dei nodi riallocati da compact (nullptr se assente).
+	unsigned int _block_nodes; // Capacita' del blocco in nodi.
+	unsigned int _block_live; // Nodi del blocco non ancora distrutti.
+
+	typedef typename bstree_comparator<T, C>::type compare_type;
+	compare_type _conf; // Comparatore a tre vie per l'ordinamento.
+
+	typedef typename P::stats_type stats_type;
+	mutable stats_type _stats; // Contatori delle statistiche (vuoti se disabilitate).
+
+	typedef typename P::filter_type filter_type;
+	filter_type _filter; // Indice laterale delle chiavi (vuoto se disabilitato).
+
+	/**
+		Confronta due valori con il comparatore a tre vie aggiornando le statistiche.
+
+		@return valore negativo se a precede b, positivo se b precede a, 0 se equivalenti.
+	*/
+	int compare(const T &a, const T &b) const {
+		_stats.count_compare();
+		return _conf(a, b);
+	}
+
+	/**
+		Calcola il prefisso di una chiave (0 se il comparatore non lo supporta).
+
+		@param value chiave.
+	*/
+	static std::uint64_t key_prefix(const T &value) {
+		return bstree_prefix_of<T, C>::get(value);
+	}
+
+	/**
+		Confronta una chiave con il valore di un nodo. Se i prefissi sono diversi il
+		risultato e' deciso dal confronto tra interi, altrimenti si usa compare_tail
+		del comparatore, se esiste, oppure il comparatore. Senza prefisso il primo
+		confronto e' costante e viene eliminato dal compilatore.
+
+		@param value chiave.
+		@param prefix prefisso della chiave.
+		@param n nodo da confrontare.
+
+		@return valore negativo se la chiave precede il nodo, positivo se lo segue, 0 se equivalenti.
+	*/
+	int compare_node(const T &value, std::uint64_t prefix, const node *n) const {
+		if(prefix != n->prefix())
+			return (prefix < n->prefix()) ? -1 : 1;
+		_stats.count_compare();
+		return bstree_compare_tail<T, C>::get(_conf, value, n->value);
+	}
+
+	/**
+		Funzione helper che cerca il nodo con il valore dato scendendo dalla radice.
+
+		@param value valore da cercare.
+
+		@return puntatore al nodo, nullptr se non esiste.
+	*/
+    node *find_node(const T &value) const {
+        if(!_filter.may_contain(value))
+            return nullptr;
+        std::uint64_t prefix = key_prefix(value);
+        node *curr = _root;
+        while(curr) {
+            _stats.count_visit();
+            int c = compare_node(value, prefix, curr);
+            if(c == 0)
+                return curr;
+            curr = (c < 0) ? curr->left : curr->right;
+        }
+        return nullptr;
+    }
 
-	C _conf; // Funtore per l'ordinamento.
-    E _equal; // Funtore per l'uguaglianza.
-    
     /**
 		Costruttore che permette di creare
 
 		@param n nodo da cui creare l'albero. 
 	*/
-    bstree(node *n) : _root(nullptr), _size(0) {
+    bstree(node *n) : _root(nullptr), _head(nullptr), _tail(nullptr), _size(0), _block(nullptr), _block_nodes(0), _block_live(0) {
         copy_helper(n); 
     }
 
@@ -120,7 +739,7 @@ class bstree {
 
 		try {
             if(n) {
-                insert(n->value);
+                insert_node(n->value)->set_count(n->count());
                 copy_helper(n->right);
                 copy_helper(n->left);
             }
@@ -132,40 +751,105 @@ class bstree {
     }
     
     /**
-		Funzione helper per la rimozione ricorsiva dei nodi.
+		Funzione helper che cerca il nodo con il valore dato, come find_node. Con la
+		policy splay porta alla radice il nodo trovato oppure, se il valore non
+		esiste, l'ultimo nodo visitato.
+
+		@param value valore da cercare.
 
-		@param n nodo da rimuovere 
+		@return puntatore al nodo, nullptr se non esiste.
 	*/
-	void clear_helper(node *n) {
-		if(n) {
-			clear_helper(n->left);
-			clear_helper(n->right);
-            clear_helper(n->next);
-			delete n;
-			n = nullptr;	
-		}
-	}
-    
+    node *access_node(const T &value) {
+        if(!_filter.may_contain(value))
+            return nullptr;
+        std::uint64_t prefix = key_prefix(value);
+        node *curr = _root;
+        node *last = nullptr;
+        while(curr) {
+            _stats.count_visit();
+            last = curr;
+            int c = compare_node(value, prefix, curr);
+            if(c == 0)
+                break;
+            curr = (c < 0) ? curr->left : curr->right;
+        }
+        if(P::splay && last)
+            splay(last);
+        return curr;
+    }
+
     /**
-		Funzione helper per determinare l'esistenza di un nodo nell'albero. 
-        L'uguaglianza è definita dal funtore di confronto.
+		Funzione helper che cerca un nodo con un funtore di confronto eterogeneo,
+		ad esempio tra una chiave e il valore di un nodo. La chiave viene prima
+		controllata nell'indice laterale, il cui funtore di hash deve quindi
+		accettare sia la chiave sia il valore dei nodi e dare lo stesso risultato.
 
-		@param n nodo da confrontare.
-		@param value valore da cercare.
+		@param cmp funtore che ritorna <0, 0, >0 confrontando la chiave cercata con il valore di un nodo.
+		@param key chiave cercata, passata all'indice laterale.
 
-		@return TRUE se esiste l'elemento.
-	*/
-    bool search_helper(node *n, const T &value) const { 
-    if (!n) //m==nullptr
-        return false; 
-  
-    if (_equal(n->value, value))
-        return true;
-  
-    bool l = search_helper(n->left, value);
-    bool r = search_helper(n->right, value);
+		@return puntatore al nodo, nullptr se non esiste.
+	*/
+    template <typename F, typename K>
+    node *find_node_with(F cmp, const K &key) const {
+        if(!_filter.may_contain(key))
+            return nullptr;
+        node *curr = _root;
+        while(curr) {
+            _stats.count_visit();
+            _stats.count_compare();
+            int c = cmp(curr->value);
+            if(c == 0)
+                return curr;
+            curr = (c < 0) ? curr->left : curr->right;
+        }
+        return nullptr;
+    }
+
+    /**
+		Funzione helper che con un'unica discesa cerca un nodo con un funtore di
+		confronto eterogeneo e, se non esiste, lo crea costruendo il valore sul posto.
+
+		@param cmp funtore che ritorna <0, 0, >0 confrontando la chiave cercata con il valore di un nodo.
+		@param args parametri del costruttore di T, usati solo se il nodo viene creato.
+
+		@return il nodo e TRUE se e' stato creato.
+		@throw eccezione di allocazione di memoria.
+	*/
+    template <typename F, typename... Args>
+    std::pair<node *, bool> find_or_emplace(F cmp, Args&&... args) {
+        _stats.count_operation();
+        
+        node *curr = _root;
+        node *pred = nullptr;
+        int c = 0;
+        while(curr) {
+            _stats.count_visit();
+            _stats.count_compare();
+            pred = curr;
+            c = cmp(curr->value);
+            if(c == 0) {
+                if(P::splay)
+                    splay(curr);
+                return std::make_pair(curr, false);
+            }
+            curr = (c < 0) ? curr->left : curr->right;
+        }
+        
+        node *tmp = new node(emplace_tag(), std::forward<Args>(args)...);
+        _stats.count_allocation();
+        tmp->set_prefix(key_prefix(tmp->value));
+        tmp->p = pred;
         
-    return (l || r); 
+        if(!pred) _root = tmp;
+        else if(c < 0) pred->left = tmp;
+        else pred->right = tmp;
+        append_next(tmp);
+        
+        _size++;
+        filter_add(tmp);
+        if(P::splay)
+            splay(tmp);
+        return std::make_pair(tmp, true);
     }
     
     /**
@@ -208,27 +892,67 @@ class bstree {
     }
     
     /**
-		Funzione helper per determinare il valore massimo in un albero.
+		Funzione helper per determinare il nodo con il valore massimo in un albero.
 
-		@param n nodo di ricorsione.
+		@param n radice dell'albero.
 	*/
-    T getMax_helper(node *n) const {
+    node *getMax_helper(node *n) const {
         while(n->right) {
+            _stats.count_visit();
             n = n->right;
         }
-        return n->value;
+        return n;
     }
     
     /**
-		Funzione helper per determinare il valore minimo in un albero.
+		Funzione helper per determinare il nodo con il valore minimo in un albero.
 
-		@param n nodo di ricorsione.
+		@param n radice dell'albero.
 	*/
-    T getMin_helper(node *n) const {
+    node *getMin_helper(node *n) const {
         while(n->left) {
+            _stats.count_visit();
             n = n->left;
         }
-        return n->value;
+        return n;
+    }
+    
+    /**
+		Funzione helper per determinare il nodo successore (secondo l'ordinamento) di un nodo.
+
+		@param n nodo da cui determinare il successore.
+
+		@return nodo successore, nullptr se n e' il massimo.
+	*/
+    node *successor_node(const node *n) const {
+        if(n->right)
+            return getMin_helper(n->right);
+        
+        node *prev = n->p;
+        while(prev && (n==prev->right)) {
+            n = prev;
+            prev = prev->p;
+        }
+        return prev;
+    }
+    
+    /**
+		Funzione helper per determinare il nodo predecessore (secondo l'ordinamento) di un nodo.
+
+		@param n nodo da cui determinare il predecessore.
+
+		@return nodo predecessore, nullptr se n e' il minimo.
+	*/
+    node *predecessor_node(const node *n) const {
+        if(n->left)
+            return getMax_helper(n->left);
+        
+        node *prev = n->p;
+        while(prev && (n==prev->left)) {
+            n = prev;
+            prev = prev->p;
+        }
+        return prev;
     }
     
     /**
@@ -238,22 +962,12 @@ class bstree {
 		@throw limit_value_exception().
 	*/
     T successor_helper(node *n) const {
-        if(_equal(getMax_helper(_root), n->value)) {
+        node *succ = successor_node(n);
+        if(!succ) {
             std::cerr << "No Successor." << std::endl;
             throw limit_value_exception();
         }
-        
-        node *curr = n;
-        
-        if(curr->right) {
-            return getMin_helper(curr->right);
-        } 
-        node *prev = curr->p;
-        while(prev && (curr==prev->right)) {
-            curr = prev;
-            prev = prev->p;
-        }
-        return prev->value;
+        return succ->value;
     }
     
     /**
@@ -263,84 +977,609 @@ class bstree {
 		@throw limit_value_exception().
 	*/
     T predecessor_helper(node *n) const {
-        if(_equal(getMin_helper(_root), n->value)) {
+        node *pred = predecessor_node(n);
+        if(!pred) {
             std::cerr << "No Predecessor." << std::endl;
             throw limit_value_exception();
         }
+        return pred->value;
+    }
+    
+    /**
+		Funtore che ordina gli indici di un lotto di valori secondo il comparatore dell'albero.
+		Usato da insert_bulk.
+	*/
+    struct batch_index_less {
+        const bstree *tree; // Albero di cui usare il comparatore.
+        const std::vector<T> *batch; // Lotto di valori.
         
-        node *curr = n;
-        
-        if(curr->left) {
-            return getMax_helper(curr->left);
-        } 
-        node *prev = curr->p;
-        while(prev && (curr==prev->left)) {
-            curr = prev;
-            prev = prev->p;
+        bool operator()(std::size_t a, std::size_t b) const {
+            return tree->compare((*batch)[a], (*batch)[b]) < 0;
         }
-        return prev->value;
-    }
+    };
     
     /**
-		Funzione che inserisce un valore in funzione al puntatore next.
+		Funzione helper che collega in un albero perfettamente bilanciato i nodi
+		di un vettore ordinato, nell'intervallo [lo, hi).
+
+		@param v nodi ordinati.
+		@param lo indice iniziale.
+		@param hi indice finale (escluso).
+		@param parent genitore della radice del sottoalbero.
 
-		@param value valore da inserire nella lista.
+		@return radice del sottoalbero costruito.
+	*/
+    static node *build_balanced(const std::vector<node *> &v, std::size_t lo, std::size_t hi, node *parent) {
+        if(lo >= hi)
+            return nullptr;
+        std::size_t mid = lo + (hi - lo) / 2;
+        node *n = v[mid];
+        n->p = parent;
+        n->left = build_balanced(v, lo, mid, n);
+        n->right = build_balanced(v, mid + 1, hi, n);
+        return n;
+    }
+
+    /**
+		Intervallo [lo, hi) delle sequenze di valori uguali di un lotto ordinato
+		associato a un nodo: il sottoalbero da visitare oppure, per un figlio
+		vuoto, il genitore e il lato a cui appendere i nuovi nodi. Usato da bulk_split.
+	*/
+    struct bulk_range {
+        node *n; // Radice del sottoalbero oppure genitore del figlio vuoto.
+        bool right; // Lato del figlio vuoto.
+        std::size_t lo; // Prima sequenza.
+        std::size_t hi; // Sequenza finale (esclusa).
+    };
+
+    /**
+		Funzione helper di insert_bulk per i lotti piccoli: divide il lotto ordinato
+		scendendo dalla radice e appende i nuovi valori ai figli vuoti come
+		sottoalberi bilanciati. L'albero viene modificato solo dopo aver allocato
+		tutti i nuovi nodi.
+
+		@param batch lotto di valori.
+		@param order indici del lotto in ordine (stabile).
+		@param created nodo creato per ogni valore del lotto (nullptr se non creato).
+		@throw eccezione di allocazione di memoria (l'albero non viene modificato).
+
+		@return numero di nodi creati.
+	*/
+    unsigned int bulk_split(const std::vector<T> &batch, const std::vector<std::size_t> &order, std::vector<node *> &created) {
+        // Sequenze di valori uguali: la j-esima e' [runs[j], runs[j+1]) in order
+        std::vector<std::size_t> runs;
+        for(std::size_t i = 0; i < order.size(); ++i)
+            if(i == 0 || compare(batch[order[i - 1]], batch[order[i]]) != 0)
+                runs.push_back(i);
+        runs.push_back(order.size());
+        std::size_t u = runs.size() - 1;
+        if(u == 0)
+            return 0;
+
+        std::vector<bulk_range> attach;
+        std::vector<std::pair<node *, std::size_t> > existing;
+        std::vector<bulk_range> stack;
+        bulk_range all = { _root, false, 0, u };
+        if(_root)
+            stack.push_back(all);
+        else
+            attach.push_back(all);
+
+        while(!stack.empty()) {
+            bulk_range a = stack.back();
+            stack.pop_back();
+            node *n = a.n;
+            _stats.count_visit();
+
+            std::size_t m = a.lo;
+            std::size_t h = a.hi;
+            while(m < h) {
+                std::size_t mid = m + (h - m) / 2;
+                if(compare(batch[order[runs[mid]]], n->value) < 0)
+                    m = mid + 1;
+                else
+                    h = mid;
+            }
+            std::size_t r = m;
+            if(m < a.hi && compare(batch[order[runs[m]]], n->value) == 0) {
+                existing.push_back(std::make_pair(n, m));
+                r = m + 1;
+            }
+
+            if(a.lo < m) {
+                bulk_range b = { n->left ? n->left : n, false, a.lo, m };
+                if(n->left)
+                    stack.push_back(b);
+                else
+                    attach.push_back(b);
+            }
+            if(r < a.hi) {
+                bulk_range b = { n->right ? n->right : n, true, r, a.hi };
+                if(n->right)
+                    stack.push_back(b);
+                else
+                    attach.push_back(b);
+            }
+        }
+
+        std::vector<node *> fresh;
+        fresh.reserve(u - existing.size());
+        try {
+            for(std::size_t i = 0; i < attach.size(); ++i)
+                for(std::size_t j = attach[i].lo; j < attach[i].hi; ++j) {
+                    const T &v = batch[order[runs[j]]];
+                    node *x = new node(v);
+                    fresh.push_back(x);
+                    _stats.count_allocation();
+                    x->set_prefix(key_prefix(v));
+                    x->set_count(runs[j + 1] - runs[j]);
+                    created[order[runs[j]]] = x;
+                }
+        }
+        catch(...) {
+            for(std::size_t i = 0; i < fresh.size(); ++i)
+                delete fresh[i];
+            for(std::size_t i = 0; i < created.size(); ++i)
+                created[i] = nullptr;
+            throw;
+        }
+
+        std::size_t f = 0;
+        for(std::size_t i = 0; i < attach.size(); ++i) {
+            const bulk_range &a = attach[i];
+            node *sub = build_balanced(fresh, f, f + (a.hi - a.lo), a.n);
+            if(!a.n)
+                _root = sub;
+            else if(a.right)
+                a.n->right = sub;
+            else
+                a.n->left = sub;
+            f += a.hi - a.lo;
+        }
+        for(std::size_t i = 0; i < existing.size(); ++i)
+            for(std::size_t c = runs[existing[i].second + 1] - runs[existing[i].second]; c; --c)
+                existing[i].first->increment();
+        return fresh.size();
+    }
+
+    /**
+		Funzione helper di insert_bulk per i lotti grandi: fonde il lotto ordinato
+		con la visita inorder dell'albero e ricollega tutti i nodi in un albero
+		perfettamente bilanciato.
+
+		@param batch lotto di valori.
+		@param order indici del lotto in ordine (stabile).
+		@param created nodo creato per ogni valore del lotto (nullptr se non creato).
 		@throw eccezione di allocazione di memoria.
+
+		@return numero di nodi creati.
 	*/
-    void insert_next(const T& value) {
-        if(search_next(value)) return;
+    unsigned int bulk_merge(const std::vector<T> &batch, const std::vector<std::size_t> &order, std::vector<node *> &created) {
+        std::size_t k = batch.size();
+        std::vector<node *> merged;
+        merged.reserve(_size + k);
+        node *t = _root ? getMin_helper(_root) : nullptr;
+        unsigned int added = 0;
+        // Ripetizioni da aggiungere ai nodi gia' presenti, applicate solo dopo le allocazioni
+        std::vector<std::pair<node *, std::size_t> > repeats;
+
+        try {
+            std::size_t i = 0;
+            while(i < k) {
+                const T &v = batch[order[i]];
+                int c = t ? compare(t->value, v) : 1;
+                if(c < 0) {
+                    merged.push_back(t);
+                    t = successor_node(t);
+                    continue;
+                }
+                std::size_t run = i;
+                for(++i; i < k && compare(batch[order[i]], v) == 0; ++i)
+                    ;
+                if(c > 0) {
+                    node *x = new node(v);
+                    _stats.count_allocation();
+                    x->set_prefix(key_prefix(v));
+                    x->set_count(i - run);
+                    created[order[run]] = x;
+                    merged.push_back(x);
+                    ++added;
+                }
+                else {
+                    repeats.push_back(std::make_pair(t, i - run));
+                }
+            }
+        }
+        catch(...) {
+            for(std::size_t i = 0; i < k; ++i) {
+                delete created[i];
+                created[i] = nullptr;
+            }
+            throw;
+        }
+
+        for(; t; t = successor_node(t))
+            merged.push_back(t);
+
+        _root = build_balanced(merged, 0, merged.size(), nullptr);
+        for(std::size_t i = 0; i < repeats.size(); ++i)
+            for(std::size_t c = repeats[i].second; c; --c)
+                repeats[i].first->increment();
+        return added;
+    }
+
+    static const unsigned int batch_group = 16; // Numero di discese eseguite insieme da search_batch.
+
+    /**
+		Richiede al processore il caricamento in cache del nodo n.
+
+		@param n nodo da caricare.
+	*/
+    static void prefetch(const node *n) {
+#if defined(__GNUC__)
+        __builtin_prefetch(n);
+#else
+        (void)n;
+#endif
+    }
+
+    /**
+		Funzione helper di insert: inserisce un valore e ritorna il suo nodo.
+		Se il valore e' gia' presente ritorna il nodo esistente (incrementandone il
+		contatore con la policy multiset).
+
+		@param value valore da inserire.
+		@throw eccezione di allocazione di memoria.
+
+		@return nodo che contiene il valore.
+	*/
+    node *insert_node(const T &value) {
+        _stats.count_operation();
+        
+        std::uint64_t prefix = key_prefix(value);
+        node *curr = _root;
+        node *pred = nullptr;
+        int c = 0;
+        while(curr) {
+            _stats.count_visit();
+            pred = curr;
+            c = compare_node(value, prefix, curr);
+            if(c == 0) {
+                curr->increment();
+                if(P::splay)
+                    splay(curr);
+                return curr;
+            }
+            curr = (c < 0) ? curr->left : curr->right;
+        }
+        
         node *tmp;
         
         try {
             tmp = new node(value);
+            _stats.count_allocation();
         }
-        catch (...) {
+        catch(...) {
             throw;
         }
+        tmp->set_prefix(prefix);
+        tmp->p = pred;
         
-        if(!_root) {
-            _root = tmp;
+        if(!pred) _root = tmp;
+        else if(c < 0) {
+            pred->left = tmp;
         }
+        else {
+            pred->right = tmp;
+        }
+        append_next(tmp);
         
-        node *curr = _root;
+        _size++;
+        filter_add(tmp);
+        if(P::splay)
+            splay(tmp);
+        return tmp;
+    }
+
+    /**
+		Funzione helper di search_batch e find_batch: esegue al piu' batch_group
+		discese contemporaneamente, avanzando ciascuna di un livello per passo.
+
+		@param keys valori da cercare.
+		@param m numero di valori (al piu' batch_group).
+		@param out nodi trovati, nullptr per i valori assenti.
+	*/
+    void find_batch_helper(const T *keys, unsigned int m, node **out) const {
+        node *curr[batch_group];
+        std::uint64_t prefix[batch_group];
+        unsigned int lane[batch_group];
+        unsigned int active = 0;
         
-        while(curr->next) {
-            curr = curr->next;
+        for(unsigned int j = 0; j < m; ++j) {
+            _stats.count_operation();
+            prefix[j] = key_prefix(keys[j]);
+            out[j] = nullptr;
+            curr[j] = _root;
+            if(_root && _filter.may_contain(keys[j]))
+                lane[active++] = j;
         }
-        curr->next = tmp;
-	}
-    
+        
+        while(active) {
+            unsigned int k = 0;
+            for(unsigned int a = 0; a < active; ++a) {
+                unsigned int j = lane[a];
+                node *n = curr[j];
+                _stats.count_visit();
+                int c = compare_node(keys[j], prefix[j], n);
+                if(c == 0) {
+                    out[j] = n;
+                    continue;
+                }
+                n = (c < 0) ? n->left : n->right;
+                if(n) {
+                    prefetch(n);
+                    curr[j] = n;
+                    lane[k++] = j;
+                }
+            }
+            active = k;
+        }
+    }
+
     /**
-		Funzione per determinare l'esistenza di un nodo nella lista, sempre in funzione al puntatore next. 
-        L'uguaglianza è definita dal funtore di confronto.
+		Funzione helper che calcola il numero di nodi per ogni profondita'.
+		La visita usa uno stack esplicito per gestire anche alberi degeneri.
+
+		@return vettore in cui l'elemento d e' il numero di nodi a profondita' d.
+	*/
+    std::vector<unsigned int> depth_histogram() const {
+        std::vector<unsigned int> hist;
+        std::vector<std::pair<node *, unsigned int> > stack;
+        if(_root)
+            stack.push_back(std::make_pair(_root, 0u));
         
-		@param value valore da cercare.
+        while(!stack.empty()) {
+            node *n = stack.back().first;
+            unsigned int d = stack.back().second;
+            stack.pop_back();
+            
+            if(hist.size() <= d)
+                hist.resize(d + 1, 0);
+            ++hist[d];
+            
+            if(n->left)
+                stack.push_back(std::make_pair(n->left, d + 1));
+            if(n->right)
+                stack.push_back(std::make_pair(n->right, d + 1));
+        }
+        return hist;
+    }
+    
+    /**
+		Funzione che accoda un nodo alla lista in ordine d'inserimento (puntatore next).
 
-		@return TRUE se esiste l'elemento.
+		@param n nodo da accodare.
 	*/
-    bool search_next(const T& value) const {
-        return search_next_helper(_root, value);
+    void append_next(node *n) {
+        n->prev = _tail;
+        if(_tail)
+            _tail->next = n;
+        else
+            _head = n;
+        _tail = n;
     }
     
     /**
-		Funzione helper per determinare l'esistenza di un nodo nella lista in funzione al puntatore next. 
-        L'uguaglianza è definita dal funtore di confronto.
+		Aggiunge all'indice laterale il valore di un nodo appena inserito, ricostruendo
+		l'indice da tutti i nodi quando e' pieno.
 
-		@param n nodo da confrontare.
-		@param value valore da cercare.
+		@param n nodo inserito.
+	*/
+    void filter_add(node *n) {
+        if(_filter.needs_rebuild(_size)) {
+            try {
+                _filter.rebuild(_size);
+            }
+            catch(...) {
+                // Senza memoria per l'indice: svuotato, accetta ogni valore fino al prossimo inserimento
+                _filter.clear();
+                return;
+            }
+            for(node *m = _head; m; m = m->next)
+                _filter.insert(m->value);
+        }
+        else {
+            _filter.insert(n->value);
+        }
+    }
+    
+    /**
+		Funzione che sostituisce nell'albero il sottoalbero con radice u con quello con radice v.
 
-		@return TRUE se esiste l'elemento.
+		@param u nodo da sostituire.
+		@param v nodo sostituto (puo' essere nullptr).
 	*/
-    bool search_next_helper(node *n, const T& value) const {
-        if (!n) 
-        return false; 
+    void transplant(node *u, node *v) {
+        if(!u->p)
+            _root = v;
+        else if(u == u->p->left)
+            u->p->left = v;
+        else
+            u->p->right = v;
+        if(v)
+            v->p = u->p;
+    }
+    
+    /**
+		Determina se un nodo si trova nel blocco contiguo di compact.
+
+		@param n nodo.
+	*/
+    bool in_block(const node *n) const {
+        std::less<const node *> before;
+        return _block && !before(n, _block) && before(n, _block + _block_nodes);
+    }
+
+    /**
+		Stima i byte occupati da un'allocazione dinamica: la dimensione richiesta
+		piu' un'intestazione di sizeof(std::size_t) byte, arrotondata a 2*sizeof(void*) byte.
+
+		@param bytes dimensione richiesta
+
+		@return byte occupati stimati
+	*/
+    static std::size_t allocation_footprint(std::size_t bytes) {
+        const std::size_t align = 2 * sizeof(void *);
+        return (bytes + sizeof(std::size_t) + align - 1) / align * align;
+    }
+
+    /**
+		Dealloca un nodo. I nodi del blocco di compact vengono solo distrutti e il
+		blocco viene liberato insieme al suo ultimo nodo.
+
+		@param n nodo da deallocare.
+	*/
+    void destroy_node(node *n) {
+        if(in_block(n)) {
+            n->~node();
+            if(--_block_live == 0) {
+                ::operator delete(_block);
+                _block = nullptr;
+                _block_nodes = 0;
+            }
+        }
+        else
+            delete n;
+    }
+
+    /**
+		Funzione che rimuove un nodo dall'albero e dalla lista in ordine d'inserimento e lo dealloca.
+
+		@param z nodo da rimuovere.
+	*/
+    void erase_node(node *z) {
+        if(!z->left) {
+            transplant(z, z->right);
+        }
+        else if(!z->right) {
+            transplant(z, z->left);
+        }
+        else {
+            node *y = getMin_helper(z->right);
+            if(y->p != z) {
+                transplant(y, y->right);
+                y->right = z->right;
+                y->right->p = y;
+            }
+            transplant(z, y);
+            y->left = z->left;
+            y->left->p = y;
+        }
+        
+        if(z->prev)
+            z->prev->next = z->next;
+        else
+            _head = z->next;
+        if(z->next)
+            z->next->prev = z->prev;
+        else
+            _tail = z->prev;
+        
+        _filter.erase(z->value);
+        destroy_node(z);
+        _size--;
+    }
+    
+    /**
+		Rotazione a sinistra del nodo n. Il figlio destro di n prende il suo posto
+		e tutti i puntatori al genitore p vengono aggiornati.
 
-        if (_equal(n->value, value))
-            return true; 
+		@param n nodo da ruotare (deve avere un figlio destro).
+	*/
+    void rotate_left(node *n) {
+        node *r = n->right;
+        n->right = r->left;
+        if(r->left)
+            r->left->p = n;
+        r->p = n->p;
+        if(!n->p)
+            _root = r;
+        else if(n == n->p->left)
+            n->p->left = r;
+        else
+            n->p->right = r;
+        r->left = n;
+        n->p = r;
+    }
+    
+    /**
+		Rotazione a destra del nodo n. Il figlio sinistro di n prende il suo posto
+		e tutti i puntatori al genitore p vengono aggiornati.
 
-        bool l = search_next_helper(n->next, value); 
+		@param n nodo da ruotare (deve avere un figlio sinistro).
+	*/
+    void rotate_right(node *n) {
+        node *l = n->left;
+        n->left = l->right;
+        if(l->right)
+            l->right->p = n;
+        l->p = n->p;
+        if(!n->p)
+            _root = l;
+        else if(n == n->p->right)
+            n->p->right = l;
+        else
+            n->p->left = l;
+        l->right = n;
+        n->p = l;
+    }
+    
+    /**
+		Porta il nodo x alla radice con rotazioni zig, zig-zig e zig-zag (policy splay).
+
+		@param x nodo da portare alla radice.
+	*/
+    void splay(node *x) {
+        while(x->p) {
+            node *par = x->p;
+            node *g = par->p;
+            if(!g) {
+                if(x == par->left)
+                    rotate_right(par);
+                else
+                    rotate_left(par);
+            }
+            else if(x == par->left && par == g->left) {
+                rotate_right(g);
+                rotate_right(par);
+            }
+            else if(x == par->right && par == g->right) {
+                rotate_left(g);
+                rotate_left(par);
+            }
+            else if(x == par->left) {
+                rotate_right(par);
+                rotate_left(g);
+            }
+            else {
+                rotate_left(par);
+                rotate_right(g);
+            }
+        }
+    }
+    
+    /**
+		Funzione helper del metodo rebalance: esegue count rotazioni a sinistra
+		lungo la spina destra a partire dalla radice (fase "compress" di Day-Stout-Warren).
 
-        return l; 
+		@param count numero di rotazioni da eseguire.
+	*/
+    void compress(unsigned int count) {
+        node *n = _root;
+        for(unsigned int i = 0; i < count; ++i) {
+            rotate_left(n);
+            n = n->p->right;
+        }
     }
 
 public:
@@ -348,7 +1587,7 @@ public:
 	/**
 		Costruttore di default
 	*/
-	bstree() : _root(nullptr), _size(0) { }
+	bstree() : _root(nullptr), _head(nullptr), _tail(nullptr), _size(0), _block(nullptr), _block_nodes(0), _block_live(0) { }
 
 	/**
 		Costruttore di copia
@@ -356,7 +1595,7 @@ public:
 		@param other albero da copiare
 		@throw eccezione di allocazione di memoria
 	*/
-	bstree(const bstree &other) : _root(nullptr), _size(0) {
+	bstree(const bstree &other) : _root(nullptr), _head(nullptr), _tail(nullptr), _size(0), _block(nullptr), _block_nodes(0), _block_live(0) {
         copy_helper(other._root);
 	}
 
@@ -370,12 +1609,28 @@ public:
 	bstree &operator=(const bstree &other) {
 		if(this != &other) {
 			bstree tmp(other);
-			std::swap(_root,tmp._root);
-			std::swap(_size,tmp._size);
+			swap(tmp);
 		}
 		return *this;
 	}
 
+	/**
+		Scambia i nodi di due alberi in tempo costante, senza copiare ne' allocare.
+		Le statistiche restano a ciascun albero. Invalida gli iteratori di entrambi.
+
+		@param other albero con cui scambiare i nodi
+	*/
+	void swap(bstree &other) {
+		std::swap(_root,other._root);
+		std::swap(_head,other._head);
+		std::swap(_tail,other._tail);
+		std::swap(_filter,other._filter);
+		std::swap(_size,other._size);
+		std::swap(_block,other._block);
+		std::swap(_block_nodes,other._block_nodes);
+		std::swap(_block_live,other._block_live);
+	}
+
 	/**
 		Distruttore
 	*/
@@ -384,58 +1639,114 @@ public:
 	}
 
 	/**
-		Inserisce un elemento in un albero binario di ricerca. Se l'elemento fosse già presente nell'albero, questo non verrà inserito.
+		Inserisce un elemento in un albero binario di ricerca. Se l'elemento fosse già presente nell'albero, questo non verrà inserito
+		(con la policy multiset viene invece incrementato il suo contatore).
 
 		@param value valore da inserire
 		@throw eccezione di allocazione di memoria
 	*/
     void insert(const T &value) { 
-        if(search(value)) return;
-        node *tmp;
-        
-        try {
-            tmp = new node(value);
-        }
-        catch(...) {
-            throw;
-        }
-        
-        node *curr = _root;
-        node *pred = nullptr;
-        while(curr) {
-            pred = curr;
-            if (_conf(tmp->value, curr->value)) {
-                curr = pred->left;
-            }
-            else {
-                curr = curr->right;
-            }
-        }
-        tmp->p = pred;
-        
-        if(!pred) _root = tmp;
-        else if(_conf(tmp->value, pred->value)) {
-            pred->left = tmp;
-        }
-        else {
-            pred->right = tmp;
-        }
-        insert_next(value);
-        
-        _size++;
+        insert_node(value);
     }
 
+	/**
+		Rimuove un elemento dall'albero. Con la policy multiset viene rimossa una sola
+		ripetizione e il nodo viene deallocato quando il contatore arriva a zero.
+
+		@param value valore da rimuovere
+
+		@return TRUE se l'elemento era presente
+	*/
+	bool erase(const T &value) {
+		_stats.count_operation();
+		node *n = find_node(value);
+		if(!n)
+			return false;
+		if(!n->decrement())
+			erase_node(n);
+		return true;
+	}
+
+	/**
+		Ritorna il numero di ripetizioni di un valore: 0 o 1, oppure il valore del
+		contatore con la policy multiset.
+
+		@param value valore da cercare
+
+		@return numero di ripetizioni
+	*/
+	unsigned int count(const T &value) const {
+		_stats.count_operation();
+		node *n = find_node(value);
+		return n ? n->count() : 0;
+	}
+
+	/**
+		Inserisce un lotto di valori non ordinati. Il lotto viene ordinato e privato
+		dei duplicati. Se il lotto e' grande rispetto all'albero viene fuso con la
+		visita inorder dell'albero e i nodi vengono ricollegati in un albero
+		bilanciato in tempo lineare. Se il lotto e' piccolo (meno di
+		size()/log2(size()) valori) viene invece diviso scendendo dalla radice: a
+		ogni nodo la parte ordinata del lotto si separa in una meta' sinistra e una
+		destra, e i valori che arrivano a un figlio vuoto vi vengono appesi come
+		sottoalbero bilanciato, con O(k log(n/k)) confronti. I nuovi nodi vengono
+		accodati alla lista in ordine d'inserimento nell'ordine del lotto; a parita'
+		di valore viene inserito il primo (con la policy multiset le ripetizioni
+		vengono contate).
+
+		@param first iteratore di inizio del lotto
+		@param last iteratore di fine del lotto
+		@throw eccezione di allocazione di memoria (l'albero non viene modificato)
+	*/
+	template <typename IterT>
+	void insert_bulk(IterT first, IterT last) {
+		_stats.count_operation();
+
+		std::vector<T> batch;
+		for(; first != last; ++first)
+			batch.push_back(static_cast<T>(*first));
+
+		std::size_t k = batch.size();
+		std::vector<std::size_t> order(k);
+		for(std::size_t i = 0; i < k; ++i)
+			order[i] = i;
+		batch_index_less cmp = { this, &batch };
+		std::stable_sort(order.begin(), order.end(), cmp);
+
+		unsigned int lg = 0;
+		for(unsigned int s = _size; s; s >>= 1)
+			++lg;
+
+		std::vector<node *> created(k, nullptr);
+		unsigned int added = (k * lg < _size) ? bulk_split(batch, order, created) : bulk_merge(batch, order, created);
+
+		for(std::size_t i = 0; i < k; ++i)
+			if(created[i])
+				append_next(created[i]);
+		_size += added;
+		for(std::size_t i = 0; i < k; ++i)
+			if(created[i])
+				filter_add(created[i]);
+	}
+
 	/**
 		Cancella i nodi dall'albero
 	*/
 	void clear() {
-		clear_helper(_root);
-		_root = nullptr;
+		node *n = _head;
+		while(n) {
+			node *tmp = n->next;
+			destroy_node(n);
+			n = tmp;
+		}
+		_root = _head = _tail = nullptr;
+		_filter.clear();
         _size = 0;
 	}
 
 	/**
-		Ritorna il numero di elementi nell'albero
+		Ritorna il numero di elementi nell'albero (con la policy multiset, il numero
+		di valori distinti)
 
 		@return numero di elementi inseriti
 	*/
@@ -444,14 +1755,202 @@ public:
 	}
 
 	/**
-		Determina se esiste un elemento nella lista. L'uguaglianza e' definita dal funtore di confronto
+		Ritorna l'altezza dell'albero, intesa come numero di livelli.
+		La visita e' iterativa per non esaurire lo stack su alberi degeneri.
+
+		@return altezza dell'albero (0 se vuoto)
+	*/
+	unsigned int height() const {
+		return depth_histogram().size();
+	}
+
+	/**
+		Ritorna le statistiche dell'albero: i contatori della policy
+		(nulli se le statistiche sono disabilitate), l'altezza, la profondita' media
+		e l'istogramma delle profondita'.
+
+		@return istantanea delle statistiche
+	*/
+	bstree_statistics stats() const {
+		bstree_statistics s;
+		s.compares = _stats.compares();
+		s.visits = _stats.visits();
+		s.operations = _stats.operations();
+		s.allocations = _stats.allocations();
+		s.depth_histogram = depth_histogram();
+		s.height = s.depth_histogram.size();
+
+		double sum = 0;
+		for(unsigned int d = 0; d < s.depth_histogram.size(); ++d)
+			sum += static_cast<double>(d) * s.depth_histogram[d];
+		s.average_depth = _size ? sum / _size : 0.0;
+		return s;
+	}
+
+	/**
+		Ribilancia l'albero in tempo O(n) e spazio aggiuntivo O(1) con l'algoritmo
+		di Day-Stout-Warren: l'albero viene prima trasformato in una "vite" (lista
+		di figli destri) e poi compresso in un albero perfettamente bilanciato.
+		I puntatori p vengono aggiornati dalle rotazioni, mentre la lista in ordine
+		d'inserimento (puntatore next) non viene modificata.
+		Puo' essere invocato quando il rapporto tra height() e size() indica un albero degenere.
+	*/
+	void rebalance() {
+		_stats.count_operation();
+
+		node *n = _root;
+		while(n) {
+			if(n->left) {
+				rotate_right(n);
+				n = n->p;
+			}
+			else {
+				n = n->right;
+			}
+		}
+
+		unsigned int m = 1;
+		while(m <= _size + 1)
+			m <<= 1;
+		m = (m >> 1) - 1;
+
+		compress(_size - m);
+		while(m > 1) {
+			m >>= 1;
+			compress(m);
+		}
+	}
+
+	/**
+		Rialloca tutti i nodi in un unico blocco contiguo in ordine di visita per
+		livelli (BFS), cosi' i livelli alti attraversati da ogni discesa occupano
+		poche linee di cache e pagine. I puntatori left, right, p, next e prev
+		vengono ricollegati; valori, ordine d'inserimento, contatori e prefissi
+		non cambiano. Invalida gli iteratori.
+
+		@throw eccezione di allocazione di memoria o di copia dei valori (l'albero non viene modificato)
+
+		@return stima dei byte liberati: occupazione dei nodi allocati singolarmente e
+		dell'eventuale blocco precedente meno quella del nuovo blocco, supponendo che
+		ogni allocazione abbia un'intestazione di sizeof(std::size_t) byte e sia
+		arrotondata a 2*sizeof(void*) byte (0 se il nuovo blocco non occupa meno).
+		I nodi cancellati da un blocco non liberano memoria: il blocco resta allocato
+		finche' non viene distrutto il suo ultimo nodo o fino al compact successivo.
+	*/
+	std::size_t compact() {
+		_stats.count_operation();
+		if(!_root)
+			return 0;
+
+		std::vector<node *> order;
+		order.reserve(_size);
+		order.push_back(_root);
+		for(std::size_t i = 0; i < order.size(); ++i) {
+			if(order[i]->left)
+				order.push_back(order[i]->left);
+			if(order[i]->right)
+				order.push_back(order[i]->right);
+		}
+
+		std::size_t k = order.size();
+		node *block = static_cast<node *>(::operator new(k * sizeof(node)));
+		_stats.count_allocation();
+		std::size_t built = 0;
+		try {
+			for(; built < k; ++built)
+				new (block + built) node(emplace_tag(), std::move_if_noexcept(order[built]->value));
+		}
+		catch(...) {
+			while(built)
+				block[--built].~node();
+			::operator delete(block);
+			throw;
+		}
+
+		std::size_t before_bytes = _block ? allocation_footprint(_block_nodes * sizeof(node)) : 0;
+		for(std::size_t i = 0; i < k; ++i) {
+			node *o = order[i];
+			node *n = block + i;
+			n->set_count(o->count());
+			n->set_prefix(o->prefix());
+			n->left = o->left;
+			n->right = o->right;
+			n->p = o->p;
+			n->next = o->next;
+			n->prev = o->prev;
+			if(!in_block(o))
+				before_bytes += allocation_footprint(sizeof(node));
+		}
+
+		// Il vecchio nodo punta con left alla sua copia nel blocco
+		for(std::size_t i = 0; i < k; ++i)
+			order[i]->left = block + i;
+		for(std::size_t i = 0; i < k; ++i) {
+			node *n = block + i;
+			n->left = n->left ? n->left->left : nullptr;
+			n->right = n->right ? n->right->left : nullptr;
+			n->p = n->p ? n->p->left : nullptr;
+			n->next = n->next ? n->next->left : nullptr;
+			n->prev = n->prev ? n->prev->left : nullptr;
+		}
+		_root = _root->left;
+		_head = _head->left;
+		_tail = _tail->left;
+
+		for(std::size_t i = 0; i < k; ++i)
+			destroy_node(order[i]);
+		_block = block;
+		_block_nodes = _block_live = k;
+		std::size_t after_bytes = allocation_footprint(k * sizeof(node));
+		return before_bytes > after_bytes ? before_bytes - after_bytes : 0;
+	}
+
+	/**
+		Azzera i contatori delle statistiche
+	*/
+	void reset_stats() {
+		_stats.reset();
+	}
+
+	/**
+		Determina se esiste un elemento nell'albero scendendo dalla radice.
+		L'uguaglianza e' definita dal comparatore. Con la policy splay porta
+		alla radice il nodo acceduto.
+
+		@param value valore da cercare
+
+		@return TRUE se esiste l'elemento
+	*/
+    bool search(const T &value) {
+        _stats.count_operation();
+        return access_node(value) != nullptr;
+    }
+
+	/**
+		Determina se esiste un elemento nell'albero scendendo dalla radice, senza
+		modificarne la struttura anche con la policy splay.
 
 		@param value valore da cercare
 
 		@return TRUE se esiste l'elemento
 	*/
     bool search(const T &value) const {
-        return search_helper(_root, value);
+        _stats.count_operation();
+        return find_node(value) != nullptr;
+    }
+
+	/**
+		Determina se esiste un elemento nell'albero senza modificarne la struttura,
+		anche con la policy splay e su un albero non const. Puo' essere usato da
+		piu' lettori concorrenti.
+
+		@param value valore da cercare
+
+		@return TRUE se esiste l'elemento
+	*/
+    bool peek(const T &value) const {
+        _stats.count_operation();
+        return find_node(value) != nullptr;
     }
     
     /**
@@ -479,50 +1978,76 @@ public:
 		Funzione  per determinare il valore massimo in un albero
 	*/
     T getMax() const {
-        getMax_helper(_root);
+        _stats.count_operation();
+        return getMax_helper(_root)->value;
     }
     
     /**
 		Funzione  per determinare il valore minimo in un albero
 	*/
     T getMin() const {
-        getMin_helper(_root);
+        _stats.count_operation();
+        return getMin_helper(_root)->value;
     }
     
     /**
 		Funzione per determinare successore in un albero.
 
 		@param value valore del nodo di cui cercare il successore.
+		@throw element_not_found_exception se il valore non e' presente.
+		@throw limit_value_exception se il valore e' il massimo.
+	*/
+    T successor(const T &value) {
+        _stats.count_operation();
+        node *n = access_node(value);
+        if(!n)
+            throw element_not_found_exception();
+        return successor_helper(n);
+    }
+
+    /**
+		Funzione per determinare successore in un albero const, senza rotazioni.
+
+		@param value valore del nodo di cui cercare il successore.
+		@throw element_not_found_exception se il valore non e' presente.
+		@throw limit_value_exception se il valore e' il massimo.
 	*/
     T successor(const T &value) const {
-        node *curr = _root;
-        
-        while(curr) {
-            if(_equal(curr->value, value))
-                return successor_helper(curr);
-            else if(_conf(value, curr->value))
-                curr = curr->left;
-            else
-                curr = curr->right;
-        }
+        _stats.count_operation();
+        node *n = find_node(value);
+        if(!n)
+            throw element_not_found_exception();
+        return successor_helper(n);
     }
     
     /**
 		Funzione per determinare successore in un albero.
 
 		@param value valore del nodo di cui cercare il predecessore.
+		@throw element_not_found_exception se il valore non e' presente.
+		@throw limit_value_exception se il valore e' il minimo.
+	*/
+    T predecessor(const T &value) {
+        _stats.count_operation();
+        node *n = access_node(value);
+        if(!n)
+            throw element_not_found_exception();
+        return predecessor_helper(n);
+    }
+
+    /**
+		Funzione per determinare il predecessore in un albero const, senza rotazioni.
+
+		@param value valore del nodo di cui cercare il predecessore.
+		@throw element_not_found_exception se il valore non e' presente.
+		@throw limit_value_exception se il valore e' il minimo.
 	*/
     T predecessor(const T &value) const {
-        node *curr = _root;
-        
-        while(curr) {
-            if(_equal(curr->value, value))
-                return predecessor_helper(curr);
-            else if(_conf(value, curr->value))
-                curr = curr->left;
-            else
-                curr = curr->right;
-        }
+        _stats.count_operation();
+        node *n = find_node(value);
+        if(!n)
+            throw element_not_found_exception();
+        return predecessor_helper(n);
     }
     
     /**
@@ -532,24 +2057,13 @@ public:
         @throw element_not_found_exception.
 	*/
     bstree subtree(const T &value) {
-        if(!search(value))
+        _stats.count_operation();
+        node *n = find_node(value);
+        if(!n)
             throw element_not_found_exception();
         
-        node *curr = _root;
-        
-        while(curr) {
-            if(_equal(curr->value, value)) {
-                bstree bst(curr);
-                return bst;
-            }
-            
-            if(_conf(value,curr->value)) {
-                curr = curr->left;
-            }
-            else {
-                curr = curr->right;
-            }
-        }
+        bstree bst(n);
+        return bst;
     }
 
 	/**
@@ -562,7 +2076,7 @@ public:
 	*/
 	template <typename IterT>
 	bstree(IterT begin, IterT end) 
-		: _root(nullptr), _size(0) {
+		: _root(nullptr), _head(nullptr), _tail(nullptr), _size(0), _block(nullptr), _block_nodes(0), _block_live(0) {
 
 		try {
 			while(begin != end) {
@@ -583,6 +2097,8 @@ public:
 	*/
 	class const_iterator {
 		const node *_n;
+		unsigned int _rep; // Ripetizione corrente del valore (iterazione con ripetizioni).
+		bool _counted; // Se TRUE ogni valore viene restituito una volta per ripetizione.
 
 	public:
 		typedef std::forward_iterator_tag iterator_category;
@@ -591,14 +2107,17 @@ public:
 		typedef const T* pointer;
 		typedef const T& reference;
 	
-		const_iterator() : _n(nullptr) {
+		const_iterator() : _n(nullptr), _rep(0), _counted(false) {
 		}
 		
-		const_iterator(const const_iterator &other) : _n(other._n) {
+		const_iterator(const const_iterator &other) 
+			: _n(other._n), _rep(other._rep), _counted(other._counted) {
 		}
 
 		const_iterator& operator=(const const_iterator &other) {
 			_n = other._n;
+			_rep = other._rep;
+			_counted = other._counted;
 			return *this;
 		}
 
@@ -616,23 +2135,23 @@ public:
 		}
         
         const_iterator& operator++() {
-            _n = _n->next;
+            advance();
             return *this;
         }
 
         const_iterator operator++(int) {
 			const_iterator tmp(*this);
-			_n = _n->next;
+			advance();
 			return tmp;
         }
 		// Uguaglianza
 		bool operator==(const const_iterator &other) const {
-			return (_n == other._n);
+			return (_n == other._n) && (_rep == other._rep);
 		}
 		
 		// Diversita'
 		bool operator!=(const const_iterator &other) const {
-			return (_n != other._n);
+			return !(*this == other);
 		}
 
 	private:
@@ -640,10 +2159,118 @@ public:
 		// Classe container friend Per usare il costruttore di inizializzazione.
 		friend class bstree; 
 
+		// Mappa costruita sull'albero, usa il costruttore di inizializzazione in find.
+		template <typename K, typename V, typename KC, typename KP>
+		friend class bstree_map;
+
 		// Costruttore privato di inizializzazione usato dalla classe container (tipicamente nei metodi begin e end)
-		const_iterator(const node *n) : _n(n) { }
+		const_iterator(const node *n, bool counted = false) : _n(n), _rep(0), _counted(counted) { }
+
+		// Passa alla ripetizione successiva oppure al nodo successivo in ordine d'inserimento
+		void advance() {
+			if(_counted && ++_rep < _n->count())
+				return;
+			_rep = 0;
+			_n = _n->next;
+		}
         
 	}; // classe const_iterator
+
+
+	/**
+		Iteratore costante bidirezionale che visita l'albero in ordine (secondo il
+		comparatore), risalendo con i puntatori p senza memoria aggiuntiva. Con la
+		policy multiset ogni valore e' visitato una volta e count() ne ritorna le
+		ripetizioni.
+
+		@brief Iteratore costante in ordine
+	*/
+	class const_ordered_iterator {
+		const node *_n;
+		const bstree *_tree; // albero visitato, serve a operator-- dalla fine
+
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+
+		const_ordered_iterator() : _n(nullptr), _tree(nullptr) {
+		}
+
+		// Ritorna il dato riferito dall'iteratore (dereferenziamento)
+		reference operator*() const {
+			return _n->value;
+		}
+
+		// Ritorna il puntatore al dato riferito dall'iteratore
+		pointer operator->() const {
+			return &(_n->value);
+		}
+
+		// Ritorna il numero di ripetizioni del dato (1 se la policy non e' multiset)
+		unsigned int count() const {
+			return _n->count();
+		}
+
+		const_ordered_iterator& operator++() {
+			_n = inorder_next(_n);
+			return *this;
+		}
+
+		const_ordered_iterator operator++(int) {
+			const_ordered_iterator tmp(*this);
+			_n = inorder_next(_n);
+			return tmp;
+		}
+
+		// Dalla fine della visita si porta sul massimo, dal minimo sulla fine
+		const_ordered_iterator& operator--() {
+			if(_n)
+				_n = _tree->predecessor_node(_n);
+			else if(_tree->_root)
+				_n = _tree->getMax_helper(_tree->_root);
+			return *this;
+		}
+
+		const_ordered_iterator operator--(int) {
+			const_ordered_iterator tmp(*this);
+			--*this;
+			return tmp;
+		}
+
+		// Uguaglianza
+		bool operator==(const const_ordered_iterator &other) const {
+			return (_n == other._n);
+		}
+
+		// Diversita'
+		bool operator!=(const const_ordered_iterator &other) const {
+			return (_n != other._n);
+		}
+
+	private:
+
+		// Classe container friend per usare il costruttore di inizializzazione.
+		friend class bstree;
+
+		// Costruttore privato di inizializzazione usato dalla classe container
+		const_ordered_iterator(const node *n, const bstree *tree) : _n(n), _tree(tree) { }
+
+		// Ritorna il nodo successivo in ordine, nullptr dopo il massimo
+		static const node *inorder_next(const node *n) {
+			if(n->right) {
+				n = n->right;
+				while(n->left)
+					n = n->left;
+				return n;
+			}
+			while(n->p && n == n->p->right)
+				n = n->p;
+			return n->p;
+		}
+	}; // classe const_ordered_iterator
 	
 
 	/**
@@ -652,7 +2279,39 @@ public:
 		@return iteratore all'inizio della sequenza
 	*/
 	const_iterator begin() const {
-		return const_iterator(_root);
+		return const_iterator(_head);
+	}
+	
+	/**
+		Ritorna l'iteratore al valore minimo per la visita in ordine
+	
+		@return iteratore all'inizio della visita in ordine
+	*/
+	const_ordered_iterator ordered_begin() const {
+		const node *n = _root;
+		while(n && n->left)
+			n = n->left;
+		return const_ordered_iterator(n, this);
+	}
+	
+	/**
+		Ritorna l'iteratore alla fine della visita in ordine
+	
+		@return iteratore alla fine della visita in ordine
+	*/
+	const_ordered_iterator ordered_end() const {
+		return const_ordered_iterator(nullptr, this);
+	}
+	
+	/**
+		Ritorna l'iteratore all'inizio della sequenza dati in cui ogni valore viene
+		restituito una volta per ogni ripetizione (policy multiset). La fine della
+		sequenza e' end().
+	
+		@return iteratore all'inizio della sequenza
+	*/
+	const_iterator begin_counted() const {
+		return const_iterator(_head, true);
 	}
 	
 	/**
@@ -663,6 +2322,108 @@ public:
 	const_iterator end() const {
 		return const_iterator(nullptr);
 	}
+
+	/**
+		Cerca un valore senza lanciare eccezioni, allocare memoria o scrivere su uno
+		stream. Come search, con la policy splay porta alla radice il nodo acceduto.
+
+		@param value valore da cercare
+
+		@return iteratore al valore, end() se non esiste
+	*/
+	const_iterator find(const T &value) {
+		_stats.count_operation();
+		return const_iterator(access_node(value));
+	}
+
+	/**
+		Cerca un valore in un albero const senza modificarne la struttura, lanciare
+		eccezioni, allocare memoria o scrivere su uno stream.
+
+		@param value valore da cercare
+
+		@return iteratore al valore, end() se non esiste
+	*/
+	const_iterator find(const T &value) const {
+		_stats.count_operation();
+		return const_iterator(find_node(value));
+	}
+
+	/**
+		Cerca un valore senza modificare la struttura dell'albero (nemmeno con la
+		policy splay), lanciare eccezioni o scrivere su uno stream. L'iteratore
+		ritornato prosegue secondo l'ordinamento con next, prev, ++ e --.
+
+		@param value valore da cercare
+
+		@return iteratore in ordine al valore, ordered_end() se non esiste
+	*/
+	const_ordered_iterator ordered_find(const T &value) const {
+		_stats.count_operation();
+		return const_ordered_iterator(find_node(value), this);
+	}
+
+	/**
+		Ritorna il successore secondo l'ordinamento senza lanciare eccezioni ne'
+		scrivere su uno stream.
+
+		@param it iteratore in ordine a un valore dell'albero oppure ordered_end()
+
+		@return iteratore al successore, ordered_end() se it e' il massimo o ordered_end()
+	*/
+	const_ordered_iterator next(const_ordered_iterator it) const {
+		return it == ordered_end() ? it : ++it;
+	}
+
+	/**
+		Ritorna il predecessore secondo l'ordinamento senza lanciare eccezioni
+		ne' scrivere su uno stream. Il predecessore di ordered_end() e' il massimo,
+		quindi l'albero si visita all'indietro partendo da prev(ordered_end()).
+
+		@param it iteratore in ordine a un valore dell'albero oppure ordered_end()
+
+		@return iteratore al predecessore, ordered_end() se it e' il minimo
+	*/
+	const_ordered_iterator prev(const_ordered_iterator it) const {
+		return --it;
+	}
+
+	/**
+		Cerca un insieme di valori. Le discese vengono eseguite a gruppi di
+		batch_group chiavi in parallelo: ad ogni passo viene richiesto il prefetch
+		del figlio successivo di ciascuna discesa, in modo da sovrapporre le latenze
+		dei cache miss.
+
+		@param keys array dei valori da cercare
+		@param n numero di valori
+		@param out array di n booleani: out[i] e' TRUE se keys[i] esiste nell'albero
+	*/
+	void search_batch(const T *keys, std::size_t n, bool *out) const {
+		node *found[batch_group];
+		for(std::size_t i = 0; i < n; i += batch_group) {
+			unsigned int m = (n - i < batch_group) ? n - i : batch_group;
+			find_batch_helper(keys + i, m, found);
+			for(unsigned int j = 0; j < m; ++j)
+				out[i + j] = (found[j] != nullptr);
+		}
+	}
+
+	/**
+		Come search_batch, ma ritorna per ogni valore un iteratore al nodo trovato.
+
+		@param keys array dei valori da cercare
+		@param n numero di valori
+		@param out array di n iteratori: out[i] punta a keys[i], oppure e' end() se non esiste
+	*/
+	void find_batch(const T *keys, std::size_t n, const_iterator *out) const {
+		node *found[batch_group];
+		for(std::size_t i = 0; i < n; i += batch_group) {
+			unsigned int m = (n - i < batch_group) ? n - i : batch_group;
+			find_batch_helper(keys + i, m, found);
+			for(unsigned int j = 0; j < m; ++j)
+				out[i + j] = const_iterator(found[j]);
+		}
+	}
     
 };
 
@@ -674,11 +2435,11 @@ public:
 
 	@return reference allo stream di output
 */
-template <typename T, typename C, typename E>
+template <typename T, typename C, typename E, typename Pol>
 std::ostream &operator<<(std::ostream &os, 
-	const bstree<T,C,E> &bst) {
+	const bstree<T,C,E,Pol> &bst) {
 	
-	typename bstree<T,C,E>::const_iterator i,ie;
+	typename bstree<T,C,E,Pol>::const_iterator i,ie;
 	
 	i = bst.begin();
 	ie = bst.end();
@@ -700,10 +2461,10 @@ std::ostream &operator<<(std::ostream &os,
 	@param bst albero su cui verificare il predicato
 	@param pred predicato da soddisfare
 */
-template <typename T, typename C, typename E, typename P>
-void printif(const bstree<T,C,E> &bst, P pred) {
+template <typename T, typename C, typename E, typename Pol, typename P>
+void printif(const bstree<T,C,E,Pol> &bst, P pred) {
 	
-	typename bstree<T,C,E>::const_iterator i,ie;
+	typename bstree<T,C,E,Pol>::const_iterator i,ie;
 
 	i = bst.begin();
 	ie = bst.end();
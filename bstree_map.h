@@ -0,0 +1,334 @@
+#ifndef BSTREE_MAP_H
+#define BSTREE_MAP_H
+
+#include "bstree.h"
+#include <iterator> // std::forward_iterator_tag
+#include <cstddef>  // std::ptrdiff_t
+#include <tuple>    // std::forward_as_tuple
+#include <utility>  // std::pair, std::piecewise_construct
+
+/**
+	@file bstree_map.h
+	@brief Dichiarazione della classe templata bstree_map
+*/
+
+
+/**
+	Comparatore a tre vie tra coppie chiave/valore che confronta solo le chiavi.
+
+	@brief Comparatore tra coppie chiave/valore
+
+	@param K tipo della chiave
+	@param V tipo del valore
+	@param C funtore di comparazione delle chiavi (< oppure a tre vie)
+*/
+template <typename K, typename V, typename C>
+struct bstree_map_compare {
+	typename bstree_comparator<K, C>::type key_compare; // Comparatore a tre vie delle chiavi.
+
+	int operator()(const std::pair<const K, V> &a, const std::pair<const K, V> &b) const {
+		return key_compare(a.first, b.first);
+	}
+};
+
+
+/**
+	Funtore di hash che applica il funtore delle chiavi H sia a una chiave sia
+	alla chiave di una coppia, cosi' l'indice laterale della mappa registra le
+	chiavi e le ricerche per chiave possono interrogarlo.
+
+	@brief Hash della chiave di una coppia
+
+	@param K tipo della chiave
+	@param V tipo del valore
+	@param H funtore di hash delle chiavi
+*/
+template <typename K, typename V, typename H>
+struct bstree_map_key_hash {
+	H hash; // Funtore di hash delle chiavi.
+
+	std::size_t operator()(const K &key) const {
+		return hash(key);
+	}
+
+	std::size_t operator()(const std::pair<const K, V> &v) const {
+		return hash(v.first);
+	}
+};
+
+
+/**
+	Indice laterale dell'albero della mappa: il filtro di Bloom della policy
+	viene adattato per calcolare l'hash delle sole chiavi.
+
+	@brief Selezione dell'indice laterale della mappa
+*/
+template <typename K, typename V, typename F>
+struct bstree_map_filter {
+	typedef F type;
+};
+
+template <typename K, typename V, typename H>
+struct bstree_map_filter<K, V, bstree_bloom_filter<H> > {
+	typedef bstree_bloom_filter<bstree_map_key_hash<K, V, H> > type;
+};
+
+
+/**
+	Policy dell'albero della mappa: quella scelta dall'utente, con l'indice
+	laterale adattato alle chiavi.
+
+	@brief Policy dell'albero della mappa
+*/
+template <typename K, typename V, typename P>
+struct bstree_map_policy : P {
+	typedef typename bstree_map_filter<K, V, typename P::filter_type>::type filter_type;
+};
+
+
+/**
+	Classe che implementa una mappa ordinata chiave/valore sopra bstree.
+	Le coppie sono memorizzate direttamente nei nodi dell'albero: una sola discesa
+	trova la chiave e restituisce un riferimento modificabile al valore.
+	Come per bstree, l'iterazione segue l'ordine d'inserimento. Con
+	bstree_bloom_policy<H>, H calcola l'hash delle chiavi e le ricerche di
+	chiavi assenti vengono scartate dal filtro senza scendere nell'albero.
+
+	@brief Mappa ordinata basata su bstree
+
+	@param K tipo della chiave
+	@param V tipo del valore
+	@param C funtore di comparazione delle chiavi (< oppure a tre vie)
+	@param P policy dell'albero (vedi bstree_default_policy)
+*/
+template <typename K, typename V, typename C, typename P = bstree_default_policy>
+class bstree_map {
+public:
+	typedef std::pair<const K, V> value_type;
+
+private:
+	typedef bstree<value_type, bstree_map_compare<K, V, C>, void, bstree_map_policy<K, V, P> > tree_type;
+	typedef typename tree_type::node node;
+
+	tree_type _tree; // Albero che contiene le coppie.
+	typename bstree_comparator<K, C>::type _key_compare; // Comparatore a tre vie delle chiavi.
+
+	/**
+		Funtore che confronta la chiave cercata con la chiave di un nodo.
+	*/
+	struct key_lookup {
+		const bstree_map *map; // Mappa di cui usare il comparatore.
+		const K *key; // Chiave cercata.
+
+		int operator()(const value_type &v) const {
+			return map->_key_compare(*key, v.first);
+		}
+	};
+
+	/**
+		Costruisce il funtore di ricerca per una chiave.
+
+		@param key chiave cercata.
+	*/
+	key_lookup lookup(const K &key) const {
+		key_lookup l = { this, &key };
+		return l;
+	}
+
+public:
+
+	/**
+		Iteratore della mappa. Permette di modificare il valore ma non la chiave.
+
+		@brief Iteratore della mappa
+	*/
+	class iterator {
+		node *_n;
+
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef std::pair<const K, V> value_type;
+		typedef ptrdiff_t difference_type;
+		typedef value_type* pointer;
+		typedef value_type& reference;
+
+		iterator() : _n(nullptr) {
+		}
+
+		// Ritorna la coppia riferita dall'iteratore (dereferenziamento)
+		reference operator*() const {
+			return _n->value;
+		}
+
+		// Ritorna il puntatore alla coppia riferita dall'iteratore
+		pointer operator->() const {
+			return &(_n->value);
+		}
+
+		iterator& operator++() {
+			_n = _n->next;
+			return *this;
+		}
+
+		iterator operator++(int) {
+			iterator tmp(*this);
+			_n = _n->next;
+			return tmp;
+		}
+
+		// Uguaglianza
+		bool operator==(const iterator &other) const {
+			return (_n == other._n);
+		}
+
+		// Diversita'
+		bool operator!=(const iterator &other) const {
+			return (_n != other._n);
+		}
+
+	private:
+
+		// Classe container friend per usare il costruttore di inizializzazione.
+		friend class bstree_map;
+
+		// Costruttore privato di inizializzazione usato dalla classe container
+		iterator(node *n) : _n(n) { }
+	}; // classe iterator
+
+	typedef typename tree_type::const_iterator const_iterator;
+
+	/**
+		Ritorna il numero di coppie nella mappa
+
+		@return numero di coppie
+	*/
+	unsigned int size() const {
+		return _tree.size();
+	}
+
+	/**
+		Cancella tutte le coppie dalla mappa
+	*/
+	void clear() {
+		_tree.clear();
+	}
+
+	/**
+		Determina se esiste una chiave nella mappa
+
+		@param key chiave da cercare
+
+		@return TRUE se esiste la chiave
+	*/
+	bool search(const K &key) const {
+		return _tree.find_node_with(lookup(key), key) != nullptr;
+	}
+
+	/**
+		Cerca una chiave nella mappa
+
+		@param key chiave da cercare
+
+		@return iteratore alla coppia, end() se la chiave non esiste
+	*/
+	iterator find(const K &key) {
+		return iterator(_tree.find_node_with(lookup(key), key));
+	}
+
+	/**
+		Cerca una chiave nella mappa costante
+
+		@param key chiave da cercare
+
+		@return iteratore alla coppia, end() se la chiave non esiste
+	*/
+	const_iterator find(const K &key) const {
+		return const_iterator(_tree.find_node_with(lookup(key), key));
+	}
+
+	/**
+		Ritorna il valore associato alla chiave, inserendo un valore costruito
+		di default se la chiave non esiste.
+
+		@param key chiave
+		@throw eccezione di allocazione di memoria
+
+		@return reference al valore
+	*/
+	V &operator[](const K &key) {
+		return try_emplace(key).first->second;
+	}
+
+	/**
+		Inserisce una coppia costruendo il valore sul posto, solo se la chiave non esiste.
+		Se la chiave esiste gli argomenti non vengono usati.
+
+		@param key chiave
+		@param args argomenti del costruttore del valore
+		@throw eccezione di allocazione di memoria
+
+		@return iteratore alla coppia e TRUE se e' stata inserita
+	*/
+	template <typename... Args>
+	std::pair<iterator, bool> try_emplace(const K &key, Args&&... args) {
+		std::pair<node *, bool> r = _tree.find_or_emplace(lookup(key), std::piecewise_construct,
+			std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+		return std::make_pair(iterator(r.first), r.second);
+	}
+
+	/**
+		Inserisce una coppia oppure, se la chiave esiste, assegna il nuovo valore.
+
+		@param key chiave
+		@param obj valore
+		@throw eccezione di allocazione di memoria
+
+		@return iteratore alla coppia e TRUE se e' stata inserita
+	*/
+	template <typename M>
+	std::pair<iterator, bool> insert_or_assign(const K &key, M &&obj) {
+		std::pair<node *, bool> r = _tree.find_or_emplace(lookup(key), std::piecewise_construct,
+			std::forward_as_tuple(key), std::forward_as_tuple(std::forward<M>(obj)));
+		if(!r.second) // obj non e' stato usato per costruire il nodo
+			r.first->value.second = std::forward<M>(obj);
+		return std::make_pair(iterator(r.first), r.second);
+	}
+
+	/**
+		Ritorna l'iteratore all'inizio della sequenza di coppie (ordine d'inserimento)
+
+		@return iteratore all'inizio della sequenza
+	*/
+	iterator begin() {
+		return iterator(_tree._head);
+	}
+
+	/**
+		Ritorna l'iteratore alla fine della sequenza di coppie
+
+		@return iteratore alla fine della sequenza
+	*/
+	iterator end() {
+		return iterator(nullptr);
+	}
+
+	/**
+		Ritorna l'iteratore costante all'inizio della sequenza di coppie
+
+		@return iteratore all'inizio della sequenza
+	*/
+	const_iterator begin() const {
+		return _tree.begin();
+	}
+
+	/**
+		Ritorna l'iteratore costante alla fine della sequenza di coppie
+
+		@return iteratore alla fine della sequenza
+	*/
+	const_iterator end() const {
+		return _tree.end();
+	}
+};
+
+#endif
@@ -0,0 +1,477 @@
+#ifndef BSTREE_PARALLEL_H
+#define BSTREE_PARALLEL_H
+
+#include "bstree.h"
+#include <atomic>             // std::atomic
+#include <condition_variable> // std::condition_variable
+#include <deque>              // std::deque
+#include <exception>          // std::exception_ptr
+#include <functional>         // std::function
+#include <mutex>              // std::mutex, std::lock_guard, std::unique_lock
+#include <thread>             // std::thread
+#include <vector>             // std::vector
+
+/**
+	@file bstree_parallel.h
+	@brief Visite parallele di bstree su un thread pool con work stealing
+*/
+
+
+/**
+	Thread pool con una coda per thread: ogni thread esegue i propri task
+	dall'ultimo inserito e, quando la sua coda e' vuota, ruba dalle code degli
+	altri thread il task piu' vecchio (di solito il sottoalbero piu' grande).
+	Esegue un lavoro alla volta: run ritorna quando il task iniziale e tutti
+	i task generati durante l'esecuzione sono terminati.
+
+	@brief Thread pool con work stealing
+*/
+class bstree_thread_pool {
+public:
+	typedef std::function<void(unsigned int)> task; // Task, riceve l'indice del thread che lo esegue.
+
+private:
+
+	/**
+		Coda dei task di un thread.
+	*/
+	struct worker_queue {
+		std::mutex lock; // Mutex che protegge la coda.
+		std::deque<task> tasks; // Task in attesa.
+		std::atomic<unsigned int> size; // Numero di task, leggibile senza mutex.
+
+		worker_queue() : size(0) {}
+	};
+
+	std::vector<worker_queue *> _queues; // Una coda per thread.
+	std::vector<std::thread> _threads; // Thread del pool.
+	std::mutex _lock; // Mutex per le attese sulle condition variable.
+	std::condition_variable _wake; // Segnala task disponibili o la chiusura del pool.
+	std::condition_variable _done; // Segnala la fine del lavoro.
+	std::mutex _run_lock; // Serializza le chiamate a run.
+	std::atomic<unsigned int> _queued; // Task in coda.
+	std::atomic<unsigned int> _pending; // Task del lavoro corrente non ancora terminati.
+	std::atomic<bool> _failed; // TRUE se un task ha lanciato un'eccezione.
+	std::exception_ptr _error; // Prima eccezione lanciata da un task.
+	bool _stop; // TRUE quando il pool viene distrutto.
+
+	bstree_thread_pool(const bstree_thread_pool &other) = delete;
+	bstree_thread_pool &operator=(const bstree_thread_pool &other) = delete;
+
+	/**
+		Estrae un task: prima dalla coda del thread (ultimo inserito), poi rubando
+		dalle code degli altri thread (primo inserito).
+
+		@param id indice del thread
+		@param t task estratto
+
+		@return TRUE se e' stato estratto un task
+	*/
+	bool pop(unsigned int id, task &t) {
+		unsigned int n = _queues.size();
+		for(unsigned int k = 0; k < n; ++k) {
+			worker_queue &q = *_queues[(id + k) % n];
+			if(q.size.load(std::memory_order_relaxed) == 0)
+				continue;
+			std::lock_guard<std::mutex> g(q.lock);
+			if(q.tasks.empty())
+				continue;
+			if(k == 0) {
+				t = std::move(q.tasks.back());
+				q.tasks.pop_back();
+			}
+			else {
+				t = std::move(q.tasks.front());
+				q.tasks.pop_front();
+			}
+			q.size.store(q.tasks.size(), std::memory_order_relaxed);
+			--_queued;
+			return true;
+		}
+		return false;
+	}
+
+	/**
+		Ciclo di un thread del pool: esegue task finche' ce ne sono, poi attende.
+
+		@param id indice del thread
+	*/
+	void worker_loop(unsigned int id) {
+		for(;;) {
+			task t;
+			if(pop(id, t)) {
+				if(!_failed) {
+					try {
+						t(id);
+					}
+					catch(...) {
+						std::lock_guard<std::mutex> g(_lock);
+						if(!_error)
+							_error = std::current_exception();
+						_failed = true;
+					}
+				}
+				if(--_pending == 0) {
+					std::lock_guard<std::mutex> g(_lock);
+					_done.notify_all();
+				}
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lk(_lock);
+			_wake.wait(lk, [this]() { return _stop || _queued > 0; });
+			if(_stop)
+				return;
+		}
+	}
+
+public:
+
+	/**
+		Costruttore che avvia i thread del pool.
+
+		@param threads numero di thread, 0 per il numero di core
+		@throw eccezione di allocazione di memoria o di creazione dei thread
+	*/
+	explicit bstree_thread_pool(unsigned int threads = 0) : _queued(0), _pending(0), _failed(false), _stop(false) {
+		if(threads == 0)
+			threads = std::thread::hardware_concurrency();
+		if(threads == 0)
+			threads = 1;
+
+		try {
+			for(unsigned int i = 0; i < threads; ++i)
+				_queues.push_back(new worker_queue());
+			for(unsigned int i = 0; i < threads; ++i)
+				_threads.push_back(std::thread(&bstree_thread_pool::worker_loop, this, i));
+		}
+		catch(...) {
+			shutdown();
+			throw;
+		}
+	}
+
+	/**
+		Distruttore che ferma e attende i thread del pool.
+	*/
+	~bstree_thread_pool() {
+		shutdown();
+	}
+
+	/**
+		Ritorna il numero di thread del pool
+
+		@return numero di thread
+	*/
+	unsigned int size() const {
+		return _queues.size();
+	}
+
+	/**
+		Accoda un task nella coda di un thread. Da chiamare solo dentro un task
+		del lavoro corrente, che non puo' terminare prima dei task che genera.
+
+		@param worker indice del thread che accoda
+		@param t task
+		@throw eccezione di allocazione di memoria
+	*/
+	void spawn(unsigned int worker, task t) {
+		worker_queue &q = *_queues[worker];
+		++_pending;
+		try {
+			std::lock_guard<std::mutex> g(q.lock);
+			q.tasks.push_back(std::move(t));
+			q.size.store(q.tasks.size(), std::memory_order_relaxed);
+			++_queued;
+		}
+		catch(...) {
+			--_pending;
+			throw;
+		}
+		{
+			std::lock_guard<std::mutex> g(_lock);
+		}
+		_wake.notify_one();
+	}
+
+	/**
+		Determina se la coda di un thread e' vuota, cioe' se conviene generare
+		un nuovo task che altri thread possano rubare.
+
+		@param worker indice del thread
+
+		@return TRUE se la coda e' vuota
+	*/
+	bool starving(unsigned int worker) const {
+		return _queues[worker]->size.load(std::memory_order_relaxed) == 0;
+	}
+
+	/**
+		Esegue un lavoro: accoda il task iniziale e attende che tutti i task
+		generati siano terminati. Se un task lancia un'eccezione, i task non
+		ancora iniziati vengono scartati e l'eccezione viene rilanciata.
+
+		@param root task iniziale
+		@throw eccezione lanciata da un task
+	*/
+	void run(task root) {
+		std::lock_guard<std::mutex> rl(_run_lock);
+		_failed = false;
+		spawn(0, std::move(root));
+
+		std::unique_lock<std::mutex> lk(_lock);
+		_done.wait(lk, [this]() { return _pending == 0; });
+		if(_error) {
+			std::exception_ptr e = _error;
+			_error = nullptr;
+			std::rethrow_exception(e);
+		}
+	}
+
+private:
+
+	/**
+		Ferma i thread avviati e dealloca le code.
+	*/
+	void shutdown() {
+		{
+			std::lock_guard<std::mutex> g(_lock);
+			_stop = true;
+		}
+		_wake.notify_all();
+		for(unsigned int i = 0; i < _threads.size(); ++i)
+			_threads[i].join();
+		_threads.clear();
+		for(unsigned int i = 0; i < _queues.size(); ++i)
+			delete _queues[i];
+		_queues.clear();
+	}
+};
+
+
+/**
+	Struttura friend di bstree che visita i sottoalberi in parallelo.
+	L'albero non memorizza la dimensione dei sottoalberi, quindi la divisione
+	e' dinamica: durante la discesa, quando la coda del thread e' vuota, il
+	sottoalbero in attesa piu' vicino alla radice diventa un nuovo task che gli
+	altri thread possono rubare. Un thread cede lavoro solo dopo aver visitato
+	almeno spawn_grain nodi dall'ultima cessione, cosi' anche su un albero
+	degenere (una catena di figli destri) i task sono al piu' uno ogni
+	spawn_grain nodi e non uno per nodo.
+
+	@brief Visita parallela dei sottoalberi
+
+	@param B tipo dell'albero
+*/
+template <typename B>
+struct bstree_parallel {
+	typedef typename B::node node;
+
+	static const unsigned int spawn_grain = 256; // Nodi visitati tra due cessioni di lavoro.
+
+	/**
+		Visita in preordine un sottoalbero chiamando visit(worker, valore) su ogni nodo.
+		I sottoalberi destri in attesa sono in una pila: la cima viene visitata dal
+		thread stesso, il fondo (il sottoalbero piu' grande) viene ceduto agli altri.
+
+		@param pool thread pool
+		@param worker indice del thread che esegue la visita
+		@param n radice del sottoalbero
+		@param visit funtore da chiamare su ogni valore
+	*/
+	template <typename V>
+	static void visit_subtree(bstree_thread_pool &pool, unsigned int worker, const node *n, V &visit) {
+		std::vector<const node *> stack;
+		std::size_t bottom = 0; // Gli elementi prima di bottom sono gia' stati ceduti.
+		unsigned int visited = 0; // Nodi visitati dall'ultima cessione.
+		for(;;) {
+			while(n) {
+				visit(worker, n->value);
+				if(n->right)
+					stack.push_back(n->right);
+				n = n->left;
+				if(++visited >= spawn_grain && bottom < stack.size() && pool.starving(worker)) {
+					const node *r = stack[bottom++];
+					pool.spawn(worker, [&pool, r, &visit](unsigned int w) {
+						visit_subtree(pool, w, r, visit);
+					});
+					visited = 0;
+				}
+			}
+			if(stack.size() == bottom)
+				return;
+			n = stack.back();
+			stack.pop_back();
+		}
+	}
+
+	/**
+		Visita tutto l'albero in parallelo.
+
+		@param pool thread pool
+		@param bst albero
+		@param visit funtore da chiamare su ogni valore
+	*/
+	template <typename V>
+	static void visit_all(bstree_thread_pool &pool, const B &bst, V &visit) {
+		const node *root = bst._root;
+		if(root == nullptr)
+			return;
+		pool.run([&pool, root, &visit](unsigned int w) {
+			visit_subtree(pool, w, root, visit);
+		});
+	}
+};
+
+
+/**
+	Adattatore che chiama il funtore di parallel_for_each ignorando il thread.
+*/
+template <typename T, typename F>
+struct bstree_for_each_visitor {
+	F *f; // Funtore dell'utente.
+
+	void operator()(unsigned int, const T &value) const {
+		(*f)(value);
+	}
+};
+
+/**
+	Adattatore che converte un valore nel tipo del risultato, usato da
+	parallel_reduce senza funtore di trasformazione.
+*/
+template <typename T, typename R>
+struct bstree_reduce_convert {
+	R operator()(const T &value) const {
+		return static_cast<R>(value);
+	}
+};
+
+/**
+	Adattatore che accumula i valori trasformati nell'accumulatore privato di
+	ogni thread. Un accumulatore vuoto parte dal primo valore che visita.
+*/
+template <typename T, typename R, typename Op, typename Tr>
+struct bstree_reduce_visitor {
+
+	// Accumulatore seguito da una linea di cache di riempimento per evitare il false sharing
+	struct slot {
+		R acc;
+		bool has; // TRUE se acc contiene almeno un valore.
+		char pad[64];
+	};
+
+	std::vector<slot> slots; // Un accumulatore per thread.
+	Op *op; // Operazione di riduzione.
+	Tr *transform; // Trasformazione dei valori.
+
+	void operator()(unsigned int worker, const T &value) {
+		slot &s = slots[worker];
+		if(s.has)
+			s.acc = (*op)(s.acc, (*transform)(value));
+		else {
+			s.acc = (*transform)(value);
+			s.has = true;
+		}
+	}
+};
+
+
+/**
+	Chiama f su ogni valore dell'albero usando i thread del pool. Come per
+	printif, f viene chiamato una volta per nodo, ma in un ordine non
+	specificato e da piu' thread contemporaneamente: deve poter essere
+	chiamato in parallelo. L'albero non deve essere modificato durante la visita.
+
+	@param pool thread pool
+	@param bst albero da visitare
+	@param f funtore da chiamare su ogni valore
+	@throw eccezione lanciata da f
+*/
+template <typename T, typename C, typename E, typename P, typename F>
+void parallel_for_each(bstree_thread_pool &pool, const bstree<T,C,E,P> &bst, F f) {
+	bstree_for_each_visitor<T, F> visit = { &f };
+	bstree_parallel<bstree<T,C,E,P> >::visit_all(pool, bst, visit);
+}
+
+/**
+	Chiama f su ogni valore dell'albero usando un pool con un thread per core.
+
+	@param bst albero da visitare
+	@param f funtore da chiamare su ogni valore
+	@throw eccezione lanciata da f
+*/
+template <typename T, typename C, typename E, typename P, typename F>
+void parallel_for_each(const bstree<T,C,E,P> &bst, F f) {
+	bstree_thread_pool pool;
+	parallel_for_each(pool, bst, f);
+}
+
+/**
+	Riduce i valori dell'albero usando i thread del pool, come std::transform_reduce:
+	il risultato e' init combinato con transform(v) per ogni valore v. Ogni thread
+	accumula i valori trasformati che visita con op(accumulatore, transform(v)),
+	partendo dal primo; alla fine gli accumulatori vengono combinati con op a
+	partire da init, che quindi viene usato una volta sola e non deve essere un
+	elemento neutro. Come per std::reduce l'ordine non e' specificato: op deve
+	essere associativa e commutativa.
+
+	@param pool thread pool
+	@param bst albero da visitare
+	@param init valore iniziale della riduzione
+	@param op funtore che combina due risultati parziali
+	@param transform funtore che trasforma un valore nel tipo del risultato
+	@throw eccezione lanciata da op o da transform
+
+	@return risultato della riduzione
+*/
+template <typename T, typename C, typename E, typename P, typename R, typename Op, typename Tr>
+R parallel_reduce(bstree_thread_pool &pool, const bstree<T,C,E,P> &bst, R init, Op op, Tr transform) {
+	bstree_reduce_visitor<T, R, Op, Tr> visit;
+	typename bstree_reduce_visitor<T, R, Op, Tr>::slot empty = { init, false, {} };
+	visit.slots.assign(pool.size(), empty);
+	visit.op = &op;
+	visit.transform = &transform;
+	bstree_parallel<bstree<T,C,E,P> >::visit_all(pool, bst, visit);
+
+	R result = init;
+	for(unsigned int i = 0; i < visit.slots.size(); ++i)
+		if(visit.slots[i].has)
+			result = op(result, visit.slots[i].acc);
+	return result;
+}
+
+/**
+	Riduce i valori dell'albero usando i thread del pool, come std::reduce:
+	il risultato e' init combinato con op con tutti i valori, convertiti in R.
+
+	@param pool thread pool
+	@param bst albero da visitare
+	@param init valore iniziale della riduzione, usato una volta sola
+	@param op funtore associativo e commutativo
+	@throw eccezione lanciata da op
+
+	@return risultato della riduzione
+*/
+template <typename T, typename C, typename E, typename P, typename R, typename Op>
+R parallel_reduce(bstree_thread_pool &pool, const bstree<T,C,E,P> &bst, R init, Op op) {
+	return parallel_reduce(pool, bst, init, op, bstree_reduce_convert<T, R>());
+}
+
+/**
+	Riduce i valori dell'albero usando un pool con un thread per core.
+
+	@param bst albero da visitare
+	@param init valore iniziale della riduzione, usato una volta sola
+	@param op funtore associativo e commutativo
+	@throw eccezione lanciata da op
+
+	@return risultato della riduzione
+*/
+template <typename T, typename C, typename E, typename P, typename R, typename Op>
+R parallel_reduce(const bstree<T,C,E,P> &bst, R init, Op op) {
+	bstree_thread_pool pool;
+	return parallel_reduce(pool, bst, init, op);
+}
+
+#endif
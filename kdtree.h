@@ -0,0 +1,259 @@
+#ifndef KDTREE_H
+#define KDTREE_H
+
+#include <algorithm>   // std::nth_element, std::push_heap, std::pop_heap, std::sort_heap
+#include <cstddef>     // std::size_t
+#include <type_traits> // std::decay
+#include <utility>     // std::declval
+#include <vector>      // std::vector
+
+/**
+	@file kdtree.h
+	@brief Dichiarazione della classe templata kdtree
+*/
+
+
+/**
+	Classe che implementa un k-d tree bidimensionale, indice spaziale per
+	ricerche in un rettangolo e dei punti piu' vicini. L'albero viene costruito
+	in blocco ed e' bilanciato: i punti sono memorizzati in un array in forma
+	implicita, dove la radice dell'intervallo [lo, hi) e' il punto mediano mid
+	secondo la coordinata del livello (x ai livelli pari, y ai dispari) e i
+	sottoalberi sono [lo, mid) e [mid+1, hi). A differenza di bstree i punti
+	ripetuti vengono mantenuti.
+
+	@brief Indice spaziale bidimensionale
+
+	@param T tipo del punto
+	@param A funtore che ritorna la coordinata di un punto: A()(p, 0) e' x, A()(p, 1) e' y
+*/
+template <typename T, typename A>
+class kdtree {
+public:
+	typedef typename std::decay<decltype(std::declval<A>()(std::declval<const T &>(), 0u))>::type coord_type;
+	typedef typename std::vector<T>::const_iterator const_iterator;
+
+private:
+	std::vector<T> _points; // Punti in forma implicita.
+	A _coord; // Funtore delle coordinate.
+
+	/**
+		Funtore che ordina i punti secondo una coordinata.
+	*/
+	struct axis_less {
+		const A *coord; // Funtore delle coordinate.
+		unsigned int axis; // Coordinata da confrontare.
+
+		bool operator()(const T &a, const T &b) const {
+			return (*coord)(a, axis) < (*coord)(b, axis);
+		}
+	};
+
+	/**
+		Candidato della ricerca dei punti piu' vicini, ordinato per distanza.
+	*/
+	struct candidate {
+		double dist; // Quadrato della distanza dal punto cercato.
+		std::size_t index; // Indice del punto in _points.
+
+		bool operator<(const candidate &other) const {
+			return dist < other.dist;
+		}
+	};
+
+	/**
+		Funzione helper della costruzione: sceglie il mediano dell'intervallo
+		secondo la coordinata del livello e costruisce ricorsivamente i sottoalberi.
+
+		@param lo inizio dell'intervallo
+		@param hi fine dell'intervallo
+		@param depth profondita' dell'intervallo
+	*/
+	void build_helper(std::size_t lo, std::size_t hi, unsigned int depth) {
+		if(hi - lo < 2)
+			return;
+		std::size_t mid = lo + (hi - lo) / 2;
+		axis_less cmp = { &_coord, depth & 1 };
+		std::nth_element(_points.begin() + lo, _points.begin() + mid, _points.begin() + hi, cmp);
+		build_helper(lo, mid, depth + 1);
+		build_helper(mid + 1, hi, depth + 1);
+	}
+
+	/**
+		Funzione helper di range_query: visita i sottoalberi che intersecano il rettangolo.
+
+		@param lo inizio dell'intervallo
+		@param hi fine dell'intervallo
+		@param depth profondita' dell'intervallo
+		@param min angolo minimo del rettangolo
+		@param max angolo massimo del rettangolo
+		@param visitor funtore da chiamare sui punti del rettangolo
+	*/
+	template <typename V>
+	void range_helper(std::size_t lo, std::size_t hi, unsigned int depth, const coord_type *min, const coord_type *max, V &visitor) const {
+		while(lo < hi) {
+			std::size_t mid = lo + (hi - lo) / 2;
+			const T &p = _points[mid];
+			unsigned int axis = depth & 1;
+			coord_type c = _coord(p, axis);
+
+			coord_type other = _coord(p, axis ^ 1);
+			if(!(c < min[axis]) && !(max[axis] < c) && !(other < min[axis ^ 1]) && !(max[axis ^ 1] < other))
+				visitor(p);
+
+			bool go_left = !(c < min[axis]);
+			bool go_right = !(max[axis] < c);
+			++depth;
+			if(go_left && go_right)
+				range_helper(lo, mid, depth, min, max, visitor);
+			if(go_right)
+				lo = mid + 1;
+			else if(go_left)
+				hi = mid;
+			else
+				return;
+		}
+	}
+
+	/**
+		Quadrato della distanza euclidea tra due punti.
+	*/
+	double distance2(const T &a, const T &b) const {
+		double dx = static_cast<double>(_coord(a, 0)) - static_cast<double>(_coord(b, 0));
+		double dy = static_cast<double>(_coord(a, 1)) - static_cast<double>(_coord(b, 1));
+		return dx * dx + dy * dy;
+	}
+
+	/**
+		Funzione helper di nearest: visita prima il sottoalbero dal lato del punto
+		cercato e l'altro solo se puo' contenere un punto piu' vicino del k-esimo trovato.
+
+		@param q punto cercato
+		@param lo inizio dell'intervallo
+		@param hi fine dell'intervallo
+		@param depth profondita' dell'intervallo
+		@param k numero di punti cercati
+		@param heap max-heap dei k candidati migliori
+	*/
+	void nearest_helper(const T &q, std::size_t lo, std::size_t hi, unsigned int depth, std::size_t k, std::vector<candidate> &heap) const {
+		if(lo >= hi)
+			return;
+		std::size_t mid = lo + (hi - lo) / 2;
+		const T &p = _points[mid];
+
+		candidate c = { distance2(q, p), mid };
+		if(heap.size() < k) {
+			heap.push_back(c);
+			std::push_heap(heap.begin(), heap.end());
+		}
+		else if(c.dist < heap.front().dist) {
+			std::pop_heap(heap.begin(), heap.end());
+			heap.back() = c;
+			std::push_heap(heap.begin(), heap.end());
+		}
+
+		unsigned int axis = depth & 1;
+		double diff = static_cast<double>(_coord(q, axis)) - static_cast<double>(_coord(p, axis));
+		if(diff < 0) {
+			nearest_helper(q, lo, mid, depth + 1, k, heap);
+			if(heap.size() < k || diff * diff < heap.front().dist)
+				nearest_helper(q, mid + 1, hi, depth + 1, k, heap);
+		}
+		else {
+			nearest_helper(q, mid + 1, hi, depth + 1, k, heap);
+			if(heap.size() < k || diff * diff < heap.front().dist)
+				nearest_helper(q, lo, mid, depth + 1, k, heap);
+		}
+	}
+
+public:
+
+	/**
+		Costruttore di default: albero vuoto
+	*/
+	kdtree() {}
+
+	/**
+		Costruttore che costruisce l'albero bilanciato da una sequenza di punti
+		in tempo O(n log n).
+
+		@param first iteratore di inizio della sequenza
+		@param last iteratore di fine della sequenza
+		@throw eccezione di allocazione di memoria
+	*/
+	template <typename IterT>
+	kdtree(IterT first, IterT last) : _points(first, last) {
+		build_helper(0, _points.size(), 0);
+	}
+
+	/**
+		Ritorna il numero di punti nell'albero
+
+		@return numero di punti
+	*/
+	std::size_t size() const {
+		return _points.size();
+	}
+
+	/**
+		Chiama visitor(p) su ogni punto p con xmin <= x <= xmax e ymin <= y <= ymax.
+		Visita solo i sottoalberi che intersecano il rettangolo: O(sqrt(n) + k) per k punti trovati.
+
+		@param xmin ascissa minima
+		@param ymin ordinata minima
+		@param xmax ascissa massima
+		@param ymax ordinata massima
+		@param visitor funtore da chiamare sui punti del rettangolo (in ordine non specificato)
+	*/
+	template <typename V>
+	void range_query(coord_type xmin, coord_type ymin, coord_type xmax, coord_type ymax, V visitor) const {
+		coord_type min[2] = { xmin, ymin };
+		coord_type max[2] = { xmax, ymax };
+		range_helper(0, _points.size(), 0, min, max, visitor);
+	}
+
+	/**
+		Cerca i k punti piu' vicini (distanza euclidea) a un punto.
+
+		@param q punto cercato
+		@param k numero di punti cercati
+		@throw eccezione di allocazione di memoria
+
+		@return al piu' k punti, dal piu' vicino al piu' lontano
+	*/
+	std::vector<T> nearest(const T &q, std::size_t k) const {
+		std::vector<candidate> heap;
+		if(k > _points.size())
+			k = _points.size();
+		heap.reserve(k);
+		if(k)
+			nearest_helper(q, 0, _points.size(), 0, k, heap);
+		std::sort_heap(heap.begin(), heap.end());
+
+		std::vector<T> result;
+		result.reserve(heap.size());
+		for(std::size_t i = 0; i < heap.size(); ++i)
+			result.push_back(_points[heap[i].index]);
+		return result;
+	}
+
+	/**
+		Ritorna l'iteratore all'inizio dei punti (in ordine non specificato)
+
+		@return iteratore all'inizio della sequenza
+	*/
+	const_iterator begin() const {
+		return _points.begin();
+	}
+
+	/**
+		Ritorna l'iteratore alla fine dei punti
+
+		@return iteratore alla fine della sequenza
+	*/
+	const_iterator end() const {
+		return _points.end();
+	}
+};
+
+#endif
@@ -1,6 +1,15 @@
 #include <iostream>
 #include "bstree.h"
+#include "bstree_map.h"
+#include "sharded_bstree.h"
+#include "bstree_parallel.h"
+#include "static_bstree.h"
+#include "kdtree.h"
 #include <cassert> // assert
+#include <vector> // std::vector
+#include <functional> // std::hash
+#include <thread> // std::thread
+#include <algorithm> // std::find
 
 
 /**
@@ -28,25 +37,17 @@ struct equal_int {
 
 
 /**
-	Funtore per il confronto tra stringhe.
-    Ritrona TRUE se la prima stringa è più piccola della seconda.
+	Comparatore a tre vie tra stringhe.
+    Ordina le stringhe per lunghezza e, a parità di lunghezza, lessicograficamente.
+    Ritorna un valore negativo se la prima stringa precede la seconda, positivo se la segue, 0 se sono uguali.
 
-	@brief Funtore per il confronto tra stringhe.
+	@brief Comparatore a tre vie tra stringhe.
 */
 struct compare_string {
-	bool operator()(const std::string &a, const std::string &b) const {
-		return (a.length()<b.length());
-	} 
-};
-
-/**
-	Funtore per l'uguaglianza tra stringhe. 
-
-	@brief Funtore per il confronto tra stringhe.
-*/
-struct equal_string {
-	bool operator()(const std::string &a, const std::string &b) const {
-		return (a==b);
+	int operator()(const std::string &a, const std::string &b) const {
+		if(a.length() != b.length())
+			return (a.length()<b.length()) ? -1 : 1;
+		return a.compare(b);
 	} 
 };
 
@@ -89,6 +90,17 @@ struct compare_point {
 	}
 };
 
+/**
+	Funtore che ritorna una coordinata di un punto: 0 per x, 1 per y.
+
+	@brief Funtore delle coordinate di un punto.
+*/
+struct point_coordinate {
+	int operator()(const point &p, unsigned int axis) const {
+		return axis ? p.y : p.x;
+	}
+};
+
 /**
 	Funtore per il confronto sull'uguaglianza tra due punti.
     Ritorna TRUE se p1.x = p2.x e p1.y = p2.y
@@ -247,7 +259,7 @@ void test_subtree() {
 void test_string() {
 	std::cout<<"****** Test su un albero di stringhe ******"<<std::endl;
 
-	bstree<std::string, compare_string, equal_string> bst;
+	bstree<std::string, compare_string> bst;
 
 	std::cout<<"Inserimento dei valori 'jimmie', 'mia', 'marsellus', 'jules 'vincent'" << std::endl;
 	bst.insert("jimmie");
@@ -271,6 +283,7 @@ void test_string() {
 	std::cout<<"Predecessore di 'jimmie': "<< bst.predecessor("jimmie") <<std::endl;
     
 	assert(bst.search("vincent") == true);
+	assert(bst.search("vincenT") == false);
 	std::cout<<"Ricerca di 'vincent': "<< bst.search("vincent") <<std::endl;
     assert(bst.search("butch") == false);
 	std::cout<<"Ricerca di 'butch': "<< bst.search("butch") <<std::endl;
@@ -310,7 +323,1006 @@ void test_point() {
 	std::cout<<"Ricerca di '(2,2)': "<<bst.search(point(2,2))<<std::endl;
 }
 
+void test_stats() {
+	std::cout << std::endl << "****** Test sulle statistiche di un albero di interi ******" << std::endl;
+
+	bstree<int, compare_int, equal_int, bstree_stats_policy> bst;
+
+	std::cout << "Inserimento dei valori 20, 15, 10, 17, 25, 30, 23" << std::endl;
+    bst.insert(20);
+    bst.insert(15);
+    bst.insert(10);
+    bst.insert(17);
+    bst.insert(25);
+    bst.insert(30);
+    bst.insert(23);
+
+	bstree_statistics s = bst.stats();
+	assert(s.height == 3);
+	assert(bst.height() == 3);
+	assert(s.allocations > 0);
+	assert(s.operations == 7);
+	assert(s.depth_histogram.size() == 3);
+	assert(s.depth_histogram[0] == 1 && s.depth_histogram[1] == 2 && s.depth_histogram[2] == 4);
+	std::cout << "Altezza: " << s.height << " profondita' media: " << s.average_depth << std::endl;
+
+	bst.reset_stats();
+	assert(bst.search(17));
+	s = bst.stats();
+	assert(s.operations == 1 && s.visits == 3 && s.compares == 3);
+	std::cout << "Ricerca di 17: " << s.visits << " nodi visitati, " << s.compares << " confronti" << std::endl;
+
+	bst.reset_stats();
+	assert(bst.search(30) && !bst.search(31));
+	s = bst.stats();
+	assert(s.visits == 6);
+	std::cout << "Inserimento ordinato dei valori da 0 a 99 (albero degenere)" << std::endl;
+	bstree<int, compare_int, equal_int, bstree_stats_policy> deg;
+	for(int i = 0; i < 100; ++i)
+		deg.insert(i);
+	assert(deg.height() == 100);
+
+	bstint nostats;
+	nostats.insert(1);
+	assert(nostats.stats().compares == 0 && nostats.stats().height == 1);
+}
+
+void test_rebalance() {
+	std::cout << std::endl << "****** Test sul ribilanciamento di un albero di interi ******" << std::endl;
+
+	std::cout << "Inserimento ordinato dei valori da 0 a 126 (albero degenere)" << std::endl;
+	bstint bst;
+	for(int i = 0; i < 127; ++i)
+		bst.insert(i);
+	assert(bst.height() == 127);
+
+	bst.rebalance();
+	std::cout << "Altezza dopo rebalance: " << bst.height() << std::endl;
+	assert(bst.height() == 7);
+	assert(bst.size() == 127);
+	assert(bst.stats().depth_histogram[6] == 64);
+
+	for(int i = 0; i < 127; ++i)
+		assert(bst.search(i));
+	assert(bst.successor(10) == 11);
+	assert(bst.predecessor(10) == 9);
+	assert(bst.getMin() == 0 && bst.getMax() == 126);
+
+	int expected = 0;
+	for(bstint::const_iterator i = bst.begin(), ie = bst.end(); i != ie; ++i, ++expected)
+		assert(*i == expected);
+	assert(expected == 127);
+
+	std::cout << "Inserimento dei valori 5, 4, 3, 2, 1, 0, 6" << std::endl;
+	bstint bst2;
+	for(int i = 5; i >= 0; --i)
+		bst2.insert(i);
+	bst2.insert(6);
+	bst2.rebalance();
+	assert(bst2.height() == 3);
+	std::cout << "Stampa preorder dopo rebalance: ";
+	bst2.print_preorder();
+	std::cout << std::endl << "Stampa con operator<<: " << bst2 << std::endl;
+
+	bstint bst3(bst2);
+	assert(bst3.size() == 7);
+	bst2.insert(7);
+	bst2.rebalance();
+	assert(bst2.height() == 4 && bst2.size() == 8);
+
+	bstint empty;
+	empty.rebalance();
+	assert(empty.height() == 0);
+}
+
+void test_comparator() {
+	std::cout << std::endl << "****** Test sul comparatore a tre vie ******" << std::endl;
+
+	bstree<std::string, compare_string, void, bstree_stats_policy> bst;
+
+	std::cout << "Inserimento dei valori 'mia', 'bob', 'ann', 'jules', 'mia'" << std::endl;
+	bst.insert("mia");
+	bst.insert("bob");
+	bst.insert("ann");
+	bst.insert("jules");
+	bst.insert("mia");
+	assert(bst.size() == 4);
+	assert(bst.successor("ann") == "bob");
+	assert(bst.predecessor("jules") == "mia");
+
+	bst.reset_stats();
+	assert(bst.search("ann"));
+	assert(bst.stats().compares == bst.stats().visits);
+	std::cout << "Confronti per la ricerca di 'ann': " << bst.stats().compares << std::endl;
+
+	bool thrown = false;
+	try {
+		bst.successor("butch");
+	}
+	catch(element_not_found_exception &e) {
+		thrown = true;
+	}
+	assert(thrown);
+
+	bstree<int, compare_int> adapted;
+	adapted.insert(3);
+	adapted.insert(1);
+	adapted.insert(3);
+	assert(adapted.size() == 2 && adapted.search(1) && !adapted.search(2));
+}
+
+void test_batch() {
+	std::cout << std::endl << "****** Test sulla ricerca a gruppi di valori interi ******" << std::endl;
+
+	bstint bst;
+	for(int i = 0; i < 100; ++i)
+		bst.insert((i * 37) % 100);
+
+	int keys[40];
+	bool out[40];
+	for(int i = 0; i < 40; ++i)
+		keys[i] = 5 * i - 50;
+
+	bst.search_batch(keys, 40, out);
+	for(int i = 0; i < 40; ++i)
+		assert(out[i] == bst.search(keys[i]));
+
+	bstint::const_iterator it[40];
+	bst.find_batch(keys, 40, it);
+	for(int i = 0; i < 40; ++i) {
+		if(out[i])
+			assert(*it[i] == keys[i]);
+		else
+			assert(it[i] == bst.end());
+	}
+	std::cout << "Ricerca di 40 valori (-50, -45, ..., 145): ok" << std::endl;
+
+	bstint empty;
+	empty.search_batch(keys, 40, out);
+	assert(!out[0] && !out[39]);
+}
+
+void test_insert_bulk() {
+	std::cout << std::endl << "****** Test sull'inserimento a lotti di valori interi ******" << std::endl;
+
+	bstint bst;
+	std::cout << "Inserimento dei valori 10, 20, 30" << std::endl;
+	bst.insert(10);
+	bst.insert(20);
+	bst.insert(30);
+
+	int batch[] = {25, 5, 20, 15, 5, 35, 0};
+	std::cout << "Inserimento a lotti dei valori 25, 5, 20, 15, 5, 35, 0" << std::endl;
+	bst.insert_bulk(batch, batch + 7);
+	std::cout << "Stampa con operator<<: " << bst << std::endl;
+	assert(bst.size() == 8);
+	assert(bst.height() == 4);
+
+	int expected[] = {10, 20, 30, 25, 5, 15, 35, 0};
+	int k = 0;
+	for(bstint::const_iterator i = bst.begin(), ie = bst.end(); i != ie; ++i, ++k)
+		assert(*i == expected[k]);
+	assert(k == 8);
+	assert(bst.successor(15) == 20 && bst.predecessor(5) == 0);
+
+	std::cout << "Inserimento a lotti dei valori da 99 a 0" << std::endl;
+	std::vector<int> v;
+	for(int i = 99; i >= 0; --i)
+		v.push_back(i);
+	bst.insert_bulk(v.begin(), v.end());
+	assert(bst.size() == 100);
+	assert(bst.height() == 7);
+	for(int i = 0; i < 100; ++i)
+		assert(bst.search(i));
+
+	std::cout << "Inserimento a lotti di un valore singolo" << std::endl;
+	int one = 1000;
+	bst.insert_bulk(&one, &one + 1);
+	assert(bst.size() == 101 && bst.getMax() == 1000);
+
+	std::cout << "Inserimento a lotti di pochi valori in un albero grande" << std::endl;
+	bstint big;
+	std::vector<int> w;
+	for(int i = 0; i < 4096; ++i)
+		w.push_back(4 * i);
+	big.insert_bulk(w.begin(), w.end());
+	int few[] = {4001, 3, 8000, 3, 16382, -7, 4001, 21};
+	big.insert_bulk(few, few + 8);
+	assert(big.size() == 4096 + 5);
+	assert(big.height() <= 14);
+	int tail[] = {4001, 3, 16382, -7, 21};
+	k = 0;
+	for(bstint::const_iterator i = big.begin(), ie = big.end(); i != ie; ++i, ++k)
+		if(k >= 4096)
+			assert(*i == tail[k - 4096]);
+	int prev = -100;
+	for(bstint::const_ordered_iterator i = big.ordered_begin(), ie = big.ordered_end(); i != ie; ++i) {
+		assert(*i > prev);
+		prev = *i;
+	}
+
+	bstree<int, compare_int, void, bstree_multiset_policy> multi;
+	multi.insert_bulk(w.begin(), w.end());
+	multi.insert_bulk(few, few + 8);
+	assert(multi.count(4001) == 2 && multi.count(3) == 2 && multi.count(8000) == 2 && multi.count(21) == 1);
+
+	bstint empty;
+	empty.insert_bulk(v.begin(), v.begin());
+	assert(empty.size() == 0);
+}
+
+/**
+	Funtore di hash degli interi che conta le chiamate, per verificare che le
+	ricerche nella mappa interroghino il filtro di Bloom.
+*/
+struct counting_hash {
+	static unsigned int calls;
+
+	std::size_t operator()(int v) const {
+		++calls;
+		return std::hash<int>()(v);
+	}
+};
+
+unsigned int counting_hash::calls = 0;
+
+void test_map() {
+	std::cout << std::endl << "****** Test sulla mappa stringa -> intero ******" << std::endl;
+
+	bstree_map<std::string, int, compare_string> map;
+
+	std::cout << "Conteggio delle parole 'mia', 'jules', 'mia', 'vincent', 'mia', 'jules'" << std::endl;
+	const char *words[] = {"mia", "jules", "mia", "vincent", "mia", "jules"};
+	for(int i = 0; i < 6; ++i)
+		++map[words[i]];
+
+	assert(map.size() == 3);
+	assert(map["mia"] == 3 && map["jules"] == 2 && map["vincent"] == 1);
+
+	bstree_map<std::string, int, compare_string>::iterator it = map.find("jules");
+	assert(it != map.end() && it->first == "jules");
+	it->second = 10;
+	assert(map["jules"] == 10);
+	assert(map.find("butch") == map.end());
+	assert(!map.search("butch"));
+
+	std::pair<bstree_map<std::string, int, compare_string>::iterator, bool> r = map.try_emplace("mia", 100);
+	assert(!r.second && r.first->second == 3);
+	r = map.try_emplace("butch", 7);
+	assert(r.second && map["butch"] == 7);
+
+	r = map.insert_or_assign("butch", 8);
+	assert(!r.second && map["butch"] == 8);
+	r = map.insert_or_assign("marsellus", 9);
+	assert(r.second && map.size() == 5);
+
+	std::cout << "Stampa con iteratori: ";
+	for(bstree_map<std::string, int, compare_string>::iterator i = map.begin(), ie = map.end(); i != ie; ++i)
+		std::cout << i->first << "=" << i->second << " ";
+	std::cout << std::endl;
+
+	const bstree_map<std::string, int, compare_string> &cmap = map;
+	assert(cmap.find("mia")->second == 3);
+	assert(cmap.find("zed") == cmap.end());
+
+	bstree_map<int, std::vector<int>, compare_int> lists;
+	lists[3].push_back(1);
+	lists[3].push_back(2);
+	lists.try_emplace(5, 4, 0);
+	assert(lists[3].size() == 2 && lists[5].size() == 4);
+
+	std::cout << "Mappa con filtro di Bloom sulle chiavi" << std::endl;
+	bstree_map<int, int, compare_int, bstree_bloom_policy<counting_hash> > filtered;
+	for(int i = 0; i < 1000; i += 2)
+		filtered[i] = i * i;
+	counting_hash::calls = 0;
+	unsigned int found = 0;
+	for(int i = 0; i < 1000; ++i)
+		found += filtered.search(i);
+	assert(found == 500 && counting_hash::calls == 1000);
+	assert(filtered.find(998)->second == 998 * 998 && filtered.find(999) == filtered.end());
+	const bstree_map<int, int, compare_int, bstree_bloom_policy<counting_hash> > &cfiltered = filtered;
+	assert(cfiltered.find(4)->second == 16 && cfiltered.find(5) == cfiltered.end());
+}
+
+/**
+	Valore intero la cui copia lancia un'eccezione quando copies_left arriva a 0
+	(-1 per disabilitare), usato per verificare la sicurezza rispetto alle eccezioni.
+*/
+struct fragile {
+	static int copies_left;
+	int v;
+
+	explicit fragile(int x) : v(x) {}
+
+	fragile(const fragile &other) : v(other.v) {
+		if(copies_left == 0)
+			throw std::runtime_error("copia fallita");
+		if(copies_left > 0)
+			--copies_left;
+	}
+
+	fragile(fragile &&other) noexcept : v(other.v) {}
+
+	fragile &operator=(const fragile &other) {
+		v = other.v;
+		return *this;
+	}
+};
+
+int fragile::copies_left = -1;
+
+std::ostream &operator<<(std::ostream &os, const fragile &f) {
+	return os << f.v;
+}
+
+/**
+	Comparatore a tre vie tra valori fragile.
+*/
+struct compare_fragile {
+	int operator()(const fragile &a, const fragile &b) const {
+		return (a.v < b.v) ? -1 : (b.v < a.v);
+	}
+};
+
+void test_multiset() {
+	std::cout << std::endl << "****** Test sul multiset di interi ******" << std::endl;
+
+	typedef bstree<int, compare_int, void, bstree_multiset_policy> multiint;
+	multiint bst;
+
+	std::cout << "Inserimento dei valori 5, 3, 5, 8, 5, 3" << std::endl;
+	bst.insert(5);
+	bst.insert(3);
+	bst.insert(5);
+	bst.insert(8);
+	bst.insert(5);
+	bst.insert(3);
+	assert(bst.size() == 3);
+	assert(bst.count(5) == 3 && bst.count(3) == 2 && bst.count(8) == 1 && bst.count(4) == 0);
+
+	std::cout << "Stampa con ripetizioni: ";
+	int n = 0;
+	for(multiint::const_iterator i = bst.begin_counted(), ie = bst.end(); i != ie; ++i, ++n)
+		std::cout << *i << " ";
+	std::cout << std::endl;
+	assert(n == 6);
+	std::cout << "Stampa con operator<<: " << bst << std::endl;
+
+	multiint copy(bst);
+	assert(copy.count(5) == 3 && copy.count(3) == 2);
+
+	assert(bst.erase(5) && bst.count(5) == 2 && bst.size() == 3);
+	assert(bst.erase(8) && bst.count(8) == 0 && bst.size() == 2);
+	assert(!bst.erase(8));
+	assert(bst.erase(3) && bst.erase(3) && bst.size() == 1);
+	assert(*bst.begin() == 5);
+
+	int batch[] = {5, 7, 7, 1};
+	bst.insert_bulk(batch, batch + 4);
+	assert(bst.count(5) == 3 && bst.count(7) == 2 && bst.count(1) == 1);
+
+	std::cout << "Rimozione da un albero di interi" << std::endl;
+	bstint set;
+	for(int i = 0; i < 20; ++i)
+		set.insert((i * 7) % 20);
+	set.insert(3);
+	assert(set.count(3) == 1);
+	for(int i = 0; i < 20; i += 2)
+		assert(set.erase(i));
+	assert(set.size() == 10);
+	for(int i = 0; i < 20; ++i)
+		assert(set.search(i) == (i % 2 == 1));
+	assert(set.getMin() == 1 && set.getMax() == 19);
+	assert(set.successor(5) == 7 && set.predecessor(5) == 3);
+	std::cout << "Stampa con operator<<: " << set << std::endl;
+	while(set.size())
+		set.erase(*set.begin());
+	assert(set.begin() == set.end());
+	set.insert(4);
+	assert(set.size() == 1 && *set.begin() == 4);
+
+	std::cout << "Inserimento a lotti interrotto da un'eccezione" << std::endl;
+	typedef bstree<fragile, compare_fragile, void, bstree_multiset_policy> fragileset;
+	fragileset f;
+	f.insert(fragile(1));
+	f.insert(fragile(2));
+	fragile fbatch[] = {fragile(1), fragile(2), fragile(3), fragile(4)};
+	fragile::copies_left = 5; // 4 copie nel lotto, il nodo di 3, poi eccezione sul nodo di 4
+	bool caught = false;
+	try {
+		f.insert_bulk(fbatch, fbatch + 4);
+	}
+	catch(std::runtime_error &e) {
+		caught = true;
+	}
+	fragile::copies_left = -1;
+	assert(caught);
+	assert(f.size() == 2 && f.count(fragile(1)) == 1 && f.count(fragile(2)) == 1 && !f.search(fragile(3)));
+	f.insert_bulk(fbatch, fbatch + 4);
+	assert(f.size() == 4 && f.count(fragile(1)) == 2 && f.count(fragile(4)) == 1);
+}
+
+void test_prefix() {
+	std::cout << std::endl << "****** Test sul prefisso delle chiavi stringa ******" << std::endl;
+
+	bstree<std::string, string_prefix_compare, void, bstree_stats_policy> bst;
+
+	std::cout << "Inserimento dei valori 'zed', 'butch', 'marsellus', 'marsellus wallace', 'mia', '', 'ab', 'ab\\0'" << std::endl;
+	bst.insert("zed");
+	bst.insert("butch");
+	bst.insert("marsellus");
+	bst.insert("marsellus wallace");
+	bst.insert("mia");
+	bst.insert("");
+	bst.insert("ab");
+	bst.insert(std::string("ab\0", 3));
+	assert(bst.size() == 8);
+
+	bst.reset_stats();
+	assert(bst.search("zed") && bst.search("mia") && !bst.search("vincent"));
+	std::cout << "Confronti tra stringhe per 3 ricerche: " << bst.stats().compares
+	          << " su " << bst.stats().visits << " nodi visitati" << std::endl;
+	assert(bst.stats().compares == 2);
+
+	assert(bst.search("marsellus wallace") && !bst.search("marsellus w"));
+	assert(bst.search(std::string("ab\0", 3)) && bst.search("ab") && bst.search(""));
+	assert(bst.getMin() == "" && bst.getMax() == "zed");
+	assert(bst.successor("ab") == std::string("ab\0", 3));
+	assert(bst.successor("marsellus") == "marsellus wallace");
+	assert(bst.predecessor("mia") == "marsellus wallace");
+	assert(string_prefix_compare::prefix("\xff") > string_prefix_compare::prefix("a"));
+
+	bstree<std::string, string_prefix_compare> copy(bst.begin(), bst.end());
+	assert(copy.search("butch") && copy.size() == 8);
+
+	std::cout << "Chiavi con un inizio comune piu' lungo di 8 byte" << std::endl;
+	assert(string_prefix_compare::compare_tail("https://b", "https://a") > 0);
+	assert(string_prefix_compare::compare_tail("https://", "https://a") < 0);
+	assert(string_prefix_compare::compare_tail(std::string("https:/\0", 8), std::string("https:/", 7)) > 0);
+	bstree<std::string, string_prefix_compare> urls;
+	const char *u[] = {"https://b.org", "https://a.org", "https://", "https:/", "https://a.org/x", "https://a.or"};
+	for(int i = 0; i < 6; ++i)
+		urls.insert(u[i]);
+	assert(urls.size() == 6 && urls.getMin() == "https:/" && urls.getMax() == "https://b.org");
+	assert(urls.successor("https://a.or") == "https://a.org" && urls.successor("https://a.org") == "https://a.org/x");
+	assert(urls.search("https://") && !urls.search("https://a") && !urls.search("https://c"));
+}
+/**
+	Policy di test che abilita sia lo splay sia le statistiche.
+
+	@brief Policy splay con statistiche.
+*/
+struct splay_stats_policy : bstree_stats_policy {
+	static const bool splay = true;
+};
+
+void test_splay() {
+	std::cout << std::endl << "****** Test sull'albero splay di interi ******" << std::endl;
+
+	typedef bstree<int, compare_int, void, splay_stats_policy> splayint;
+	splayint bst;
+
+	std::cout << "Inserimento ordinato dei valori da 0 a 99" << std::endl;
+	for(int i = 0; i < 100; ++i)
+		bst.insert(i);
+	std::cout << "Altezza: " << bst.height() << std::endl;
+
+	bst.reset_stats();
+	assert(bst.search(0));
+	std::cout << "Prima ricerca di 0: " << bst.stats().visits << " nodi visitati" << std::endl;
+	bst.reset_stats();
+	assert(bst.search(0));
+	assert(bst.stats().visits == 1);
+	std::cout << "Seconda ricerca di 0: " << bst.stats().visits << " nodo visitato" << std::endl;
+
+	bst.reset_stats();
+	assert(bst.peek(50));
+	unsigned long visits = bst.stats().visits;
+	bst.reset_stats();
+	assert(bst.peek(50));
+	assert(bst.stats().visits == visits);
+
+	std::cout << "Ricerche su un riferimento const: nessuna rotazione" << std::endl;
+	const splayint &reader = bst;
+	assert(reader.search(50) && reader.find(50) != reader.end());
+	assert(reader.successor(50) == 51 && reader.predecessor(50) == 49);
+	bst.reset_stats();
+	assert(reader.search(50));
+	assert(bst.stats().visits == visits);
+
+	assert(bst.successor(41) == 42);
+	bst.reset_stats();
+	assert(bst.search(41) && bst.stats().visits == 1);
+	assert(bst.predecessor(41) == 40);
+	assert(!bst.search(1000));
+	assert(bst.getMax() == 99 && bst.getMin() == 0);
+
+	for(int i = 0; i < 100; ++i)
+		assert(bst.peek(i));
+	int n = 0;
+	for(splayint::const_iterator i = bst.begin(), ie = bst.end(); i != ie; ++i, ++n)
+		assert(*i == n);
+	assert(n == 100);
+
+	for(int i = 0; i < 100; i += 3)
+		assert(bst.erase(i));
+	for(int i = 0; i < 100; ++i)
+		assert(bst.search(i) == (i % 3 != 0));
+	bst.rebalance();
+	assert(bst.height() == 7);
+
+	bstree<int, compare_int, void, bstree_splay_policy> copy;
+	copy.insert(2);
+	copy.insert(1);
+	copy.insert(3);
+	assert(copy.search(1) && copy.successor(2) == 3);
+}
+/**
+	Policy di test con filtro di Bloom e statistiche.
+
+	@brief Policy con filtro di Bloom e statistiche.
+*/
+struct bloom_stats_policy : bstree_stats_policy {
+	typedef bstree_bloom_filter<std::hash<int> > filter_type;
+};
+
+void test_bloom() {
+	std::cout << std::endl << "****** Test sul filtro di Bloom di un albero di interi ******" << std::endl;
+
+	typedef bstree<int, compare_int, void, bloom_stats_policy> bloomint;
+	bloomint bst;
+
+	std::cout << "Inserimento dei valori pari da 0 a 1998" << std::endl;
+	for(int i = 0; i < 1000; ++i)
+		bst.insert(2 * i);
+
+	for(int i = 0; i < 1000; ++i)
+		assert(bst.search(2 * i));
+
+	bst.reset_stats();
+	unsigned int found = 0;
+	for(int i = 0; i < 1000; ++i)
+		found += bst.search(2 * i + 1);
+	assert(found == 0);
+	std::cout << "Nodi visitati da 1000 ricerche senza successo: " << bst.stats().visits << std::endl;
+	assert(bst.stats().visits < 1000);
+
+	for(int i = 0; i < 1000; i += 2)
+		assert(bst.erase(2 * i));
+	for(int i = 0; i < 1000; ++i)
+		assert(bst.search(2 * i) == (i % 2 == 1));
+	bst.insert(4);
+	assert(bst.search(4));
+
+	int batch[] = {1, 3, 5, 7, 9};
+	bst.insert_bulk(batch, batch + 5);
+	for(int i = 0; i < 5; ++i)
+		assert(bst.search(batch[i]));
+	bool out[5];
+	bst.search_batch(batch, 5, out);
+	assert(out[0] && out[4]);
+
+	bloomint copy(bst);
+	assert(copy.search(4) && copy.search(9) && !copy.search(8));
+
+	bst.clear();
+	assert(!bst.search(4));
+	bst.insert(8);
+	assert(bst.search(8) && bst.count(8) == 1 && !bst.search(4));
+
+	bstree<int, compare_int, void, bstree_bloom_policy<std::hash<int> > > plain;
+	plain.insert(1);
+	assert(plain.search(1) && !plain.search(2));
+}
+
+void test_sharded() {
+	std::cout << std::endl << "****** Test su un albero di interi diviso in shard ******" << std::endl;
+
+	std::vector<int> sample;
+	for(int i = 0; i < 100; ++i)
+		sample.push_back(10 * i);
+	sharded_bstree<int, compare_int> sb(4, sample.begin(), sample.end());
+	assert(sb.shards() == 4);
+
+	std::cout << "Inserimento in lotto dei valori da 0 a 999 in ordine inverso" << std::endl;
+	std::vector<int> v;
+	for(int i = 999; i >= 0; --i)
+		v.push_back(i);
+	sb.insert_batch(v.begin(), v.end());
+	assert(sb.size() == 1000);
+	for(unsigned int i = 0; i < sb.shards(); ++i)
+		assert(sb.shard_size(i) == 250);
+
+	sb.insert(5);
+	sb.insert(1000);
+	assert(sb.size() == 1001);
+	assert(sb.search(0) && sb.search(999) && sb.search(1000) && !sb.search(-1));
+
+	int keys[] = {-5, 0, 250, 499, 500, 1200};
+	bool out[6];
+	sb.search_batch(keys, 6, out);
+	assert(!out[0] && out[1] && out[2] && out[3] && out[4] && !out[5]);
+
+	int expected = 0;
+	for(sharded_bstree<int, compare_int>::const_iterator i = sb.begin(), ie = sb.end(); i != ie; ++i)
+		assert(*i == expected++);
+	assert(expected == 1001);
+
+	std::cout << "Ribilanciamento dopo l'inserimento di chiavi tutte nell'ultimo shard" << std::endl;
+	for(int i = 1001; i < 4000; ++i)
+		sb.insert(i);
+	assert(sb.shard_size(3) == 3250);
+	sb.rebalance_shards();
+	assert(sb.size() == 4000);
+	for(unsigned int i = 0; i < sb.shards(); ++i)
+		assert(sb.shard_size(i) == 1000);
+	expected = 0;
+	for(sharded_bstree<int, compare_int>::const_iterator i = sb.begin(), ie = sb.end(); i != ie; ++i)
+		assert(*i == expected++);
+	assert(expected == 4000);
+
+	sharded_bstree<int, compare_int> empty(3);
+	assert(empty.size() == 0 && empty.begin() == empty.end());
+	empty.insert(1);
+	empty.insert(2);
+	empty.insert(3);
+	assert(empty.shard_size(0) == 3);
+	empty.rebalance_shards();
+	assert(empty.shard_size(0) == 1 && empty.shard_size(1) == 1 && empty.shard_size(2) == 1);
+	assert(empty.search(2));
+
+	std::cout << "Inserimenti da due thread durante il ribilanciamento" << std::endl;
+	std::thread t1([&]() { for(int i = 4000; i < 6000; ++i) sb.insert(i); });
+	std::thread t2([&]() { for(int i = 6000; i < 8000; ++i) sb.insert(i); });
+	sb.rebalance_shards();
+	t1.join();
+	t2.join();
+	sb.rebalance_shards();
+	assert(sb.size() == 8000);
+	for(int i = 0; i < 8000; ++i)
+		assert(sb.search(i));
+
+	std::cout << "Ribilanciamento di shard multiset" << std::endl;
+	sharded_bstree<int, compare_int, bstree_multiset_policy> ms(2);
+	for(int i = 0; i < 10; ++i)
+		for(int c = 0; c <= i % 3; ++c)
+			ms.insert(i);
+	ms.rebalance_shards();
+	assert(ms.size() == 10 && ms.shard_size(0) == 5 && ms.shard_size(1) == 5);
+	for(int v = 0; v < 10; ++v)
+		assert(ms.search(v));
+
+	bstree<int, compare_int, void, bstree_multiset_policy> counted;
+	counted.insert(4);
+	counted.insert(4);
+	counted.insert(2);
+	unsigned int repeats = 0;
+	for(bstree<int, compare_int, void, bstree_multiset_policy>::const_ordered_iterator i = counted.ordered_begin(), ie = counted.ordered_end(); i != ie; ++i)
+		repeats += i.count();
+	assert(repeats == 3);
+
+	std::cout << "Eccezione durante il ribilanciamento" << std::endl;
+	sharded_bstree<fragile, compare_fragile> fs(2);
+	for(int i = 0; i < 10; ++i)
+		fs.insert(fragile(i));
+	fragile::copies_left = 35; // eccezione durante la costruzione del secondo shard
+	bool thrown = false;
+	try {
+		fs.rebalance_shards();
+	}
+	catch(const std::runtime_error &) {
+		thrown = true;
+	}
+	fragile::copies_left = -1;
+	assert(thrown);
+	assert(fs.size() == 10 && fs.shard_size(0) == 10);
+	fs.insert(fragile(10));
+	assert(fs.size() == 11 && fs.search(fragile(0)) && fs.search(fragile(10)));
+	fs.rebalance_shards();
+	assert(fs.shard_size(0) + fs.shard_size(1) == 11 && fs.shard_size(1) > 0);
+}
+
+/**
+	Funtore che lancia un'eccezione su un valore, per il test delle visite parallele.
+*/
+struct throw_on_value {
+	int bad;
+
+	void operator()(int v) const {
+		if(v == bad)
+			throw std::logic_error("valore non valido");
+	}
+};
+
+void test_parallel() {
+	std::cout << std::endl << "****** Test sulle visite parallele di un albero di interi ******" << std::endl;
+
+	bstint bst;
+	std::vector<int> v;
+	for(int i = 0; i < 10000; ++i)
+		v.push_back((i * 7919) % 10000);
+	for(unsigned int i = 0; i < v.size(); ++i)
+		bst.insert(v[i]);
+
+	for(unsigned int threads = 1; threads <= 4; ++threads) {
+		std::cout << "Visita con " << threads << " thread" << std::endl;
+		bstree_thread_pool pool(threads);
+		assert(pool.size() == threads);
+
+		std::vector<std::atomic<int> > seen(10000);
+		for(unsigned int i = 0; i < seen.size(); ++i)
+			seen[i] = 0;
+		parallel_for_each(pool, bst, [&](int x) { ++seen[x]; });
+		for(unsigned int i = 0; i < seen.size(); ++i)
+			assert(seen[i] == 1);
+
+		long long sum = parallel_reduce(pool, bst, 0LL, [](long long a, long long b) { return a + b; });
+		assert(sum == 10000LL * 9999 / 2);
+
+		unsigned int evens = parallel_reduce(pool, bst, 0u,
+			[](unsigned int a, unsigned int b) { return a + b; },
+			[](int x) { return static_cast<unsigned int>(x % 2 == 0); });
+		assert(evens == 5000);
+
+		long long offset = parallel_reduce(pool, bst, 1000LL, [](long long a, long long b) { return a + b; });
+		assert(offset == 10000LL * 9999 / 2 + 1000);
+		assert(parallel_reduce(pool, bst, -1, [](int a, int b) { return a < b ? a : b; }) == -1);
+		assert(parallel_reduce(pool, bst, 20000, [](int a, int b) { return a < b ? a : b; }) == 0);
+
+		throw_on_value thrower = { 1234 };
+		bool caught = false;
+		try {
+			parallel_for_each(pool, bst, thrower);
+		}
+		catch(std::logic_error &e) {
+			caught = true;
+		}
+		assert(caught);
+
+		bstint empty;
+		assert(parallel_reduce(pool, empty, 7, [](int a, int b) { return a + b; }) == 7);
+	}
+
+	std::cout << "Visita di un albero degenere (catena di figli destri)" << std::endl;
+	bstint chain;
+	for(int i = 0; i < 5000; ++i)
+		chain.insert(i);
+	bstree_thread_pool pool4(4);
+	std::vector<std::atomic<int> > hit(5000);
+	for(unsigned int i = 0; i < hit.size(); ++i)
+		hit[i] = 0;
+	parallel_for_each(pool4, chain, [&](int x) { ++hit[x]; });
+	for(unsigned int i = 0; i < hit.size(); ++i)
+		assert(hit[i] == 1);
+	assert(parallel_reduce(pool4, chain, 0LL, [](long long a, long long b) { return a + b; }) == 5000LL * 4999 / 2);
+
+	std::atomic<int> count(0);
+	parallel_for_each(bst, [&](int) { ++count; });
+	assert(count == 10000);
+	assert(parallel_reduce(bst, 0, [](int a, int b) { return a > b ? a : b; }) == 9999);
+}
+
+void test_static() {
+	std::cout << std::endl << "****** Test su un albero di interi costruito a tempo di compilazione ******" << std::endl;
+
+	typedef static_bstree<int, 42, 7, 19, 3, 7, 100, -5, 64, 0, 23> keys;
+	static_assert(keys::size() == 9, "duplicati non eliminati");
+	static_assert(keys::height() == 4, "altezza errata");
+	static_assert(keys::search(42) && keys::search(-5) && keys::search(100), "chiave non trovata");
+	static_assert(!keys::search(8) && !keys::search(-6) && !keys::search(101), "chiave inesistente trovata");
+
+	int present[] = {-5, 0, 3, 7, 19, 23, 42, 64, 100};
+	for(int x = -10; x <= 110; ++x) {
+		bool expected = std::find(present, present + 9, x) != present + 9;
+		assert(keys::search(x) == expected);
+	}
+
+	typedef static_bstree<unsigned int, 1, 2, 3, 4, 5, 6, 7> full;
+	static_assert(full::size() == 7 && full::height() == 3, "albero pieno errato");
+	for(unsigned int x = 0; x < 10; ++x)
+		assert(full::search(x) == (x >= 1 && x <= 7));
 
+	typedef static_bstree<char, 'b'> single;
+	static_assert(single::search('b') && !single::search('a') && !single::search('c'), "una chiave");
+
+	typedef static_bstree<int> empty;
+	static_assert(empty::size() == 0 && !empty::search(0), "insieme vuoto");
+	std::cout << "Altezza dell'albero di " << keys::size() << " chiavi: " << keys::height() << std::endl;
+}
+
+void test_compact() {
+	std::cout << std::endl << "****** Test sulla compattazione dei nodi di un albero di interi ******" << std::endl;
+
+	bstint bst;
+	assert(bst.compact() == 0);
+
+	std::vector<int> v;
+	for(int i = 0; i < 1000; ++i)
+		v.push_back((i * 7919) % 1000);
+	for(unsigned int i = 0; i < v.size(); ++i)
+		bst.insert(v[i]);
+	for(int i = 0; i < 1000; i += 3)
+		bst.erase(i);
+	unsigned int height = bst.height();
+
+	std::size_t reclaimed = bst.compact();
+	std::cout << "Byte liberati (stima): " << reclaimed << std::endl;
+	assert(reclaimed > 0);
+	assert(bst.size() == 666 && bst.height() == height);
+
+	std::vector<int> order;
+	for(bstint::const_iterator i = bst.begin(), ie = bst.end(); i != ie; ++i)
+		order.push_back(*i);
+	unsigned int j = 0;
+	for(unsigned int i = 0; i < v.size(); ++i)
+		if(v[i] % 3 != 0)
+			assert(order[j++] == v[i]);
+	assert(j == order.size());
+
+	int expected = 1;
+	for(bstint::const_ordered_iterator i = bst.ordered_begin(), ie = bst.ordered_end(); i != ie; ++i) {
+		assert(*i == expected);
+		expected += (expected % 3 == 1) ? 1 : 2;
+	}
+	assert(bst.getMin() == 1 && bst.getMax() == 998 && bst.successor(4) == 5);
+
+	std::cout << "Inserimenti, cancellazioni e seconda compattazione" << std::endl;
+	for(int i = 0; i < 1000; i += 3)
+		bst.insert(i);
+	for(int i = 1; i < 1000; i += 3)
+		assert(bst.erase(i));
+	assert(bst.compact() > 0);
+	assert(bst.compact() == 0);
+	for(int i = 0; i < 1000; ++i)
+		assert(bst.search(i) == (i % 3 != 1));
+
+	bstint copy(bst);
+	assert(copy.size() == bst.size());
+	bst.clear();
+	assert(bst.size() == 0 && !bst.search(2));
+
+	bstree<int, compare_int, void, bstree_multiset_policy> multi;
+	multi.insert(5);
+	multi.insert(5);
+	multi.insert(3);
+	multi.compact();
+	assert(multi.count(5) == 2 && multi.count(3) == 1);
+	multi.erase(5);
+	assert(multi.count(5) == 1);
+
+	bstree<std::string, string_prefix_compare> words;
+	words.insert("configurazione");
+	words.insert("configurare");
+	words.insert("albero");
+	words.compact();
+	assert(words.search("configurare") && words.search("albero") && !words.search("config"));
+}
+
+/**
+	Funtore che raccoglie i punti trovati da range_query.
+*/
+struct collect_points {
+	std::vector<point> *out;
+
+	void operator()(const point &p) const {
+		out->push_back(p);
+	}
+};
+
+void test_kdtree() {
+	std::cout << std::endl << "****** Test su un k-d tree di valori point ******" << std::endl;
+
+	std::vector<point> pts;
+	for(int i = 0; i < 2000; ++i)
+		pts.push_back(point((i * 7919) % 101, (i * 104729) % 97));
+	pts.push_back(point(50, 50));
+	pts.push_back(point(50, 50));
+
+	kdtree<point, point_coordinate> kd(pts.begin(), pts.end());
+	assert(kd.size() == pts.size());
+
+	std::cout << "Ricerche in rettangoli confrontate con una scansione completa" << std::endl;
+	int boxes[][4] = { {10, 20, 30, 40}, {0, 0, 100, 96}, {50, 50, 50, 50}, {-10, -10, -1, -1}, {90, 0, 200, 5} };
+	for(int b = 0; b < 5; ++b) {
+		std::vector<point> found;
+		collect_points collect = { &found };
+		kd.range_query(boxes[b][0], boxes[b][1], boxes[b][2], boxes[b][3], collect);
+		unsigned int expected = 0;
+		for(unsigned int i = 0; i < pts.size(); ++i)
+			if(pts[i].x >= boxes[b][0] && pts[i].x <= boxes[b][2] && pts[i].y >= boxes[b][1] && pts[i].y <= boxes[b][3])
+				++expected;
+		assert(found.size() == expected);
+		for(unsigned int i = 0; i < found.size(); ++i)
+			assert(found[i].x >= boxes[b][0] && found[i].x <= boxes[b][2] && found[i].y >= boxes[b][1] && found[i].y <= boxes[b][3]);
+	}
+
+	std::cout << "Ricerca dei 5 punti piu' vicini a (33,44)" << std::endl;
+	point q(33, 44);
+	std::vector<point> near = kd.nearest(q, 5);
+	assert(near.size() == 5);
+	std::vector<int> d;
+	for(unsigned int i = 0; i < pts.size(); ++i)
+		d.push_back((pts[i].x - q.x) * (pts[i].x - q.x) + (pts[i].y - q.y) * (pts[i].y - q.y));
+	std::sort(d.begin(), d.end());
+	for(unsigned int i = 0; i < near.size(); ++i) {
+		int di = (near[i].x - q.x) * (near[i].x - q.x) + (near[i].y - q.y) * (near[i].y - q.y);
+		assert(di == d[i]);
+	}
+
+	std::vector<point> twins = kd.nearest(point(50, 50), 2);
+	assert(twins.size() == 2 && twins[0].x == 50 && twins[1].y == 50);
+	assert(kd.nearest(q, 0).empty());
+	assert(kd.nearest(q, 5000).size() == pts.size());
+
+	kdtree<point, point_coordinate> empty;
+	std::vector<point> none;
+	collect_points collect = { &none };
+	empty.range_query(0, 0, 10, 10, collect);
+	assert(none.empty() && empty.nearest(q, 3).empty() && empty.begin() == empty.end());
+}
+
+void test_neighbors() {
+	std::cout << std::endl << "****** Test su ordered_find, next e prev di un albero di interi ******" << std::endl;
+
+	bstint bst;
+	assert(bst.ordered_find(1) == bst.ordered_end() && bst.prev(bst.ordered_end()) == bst.ordered_end());
+
+	int values[] = {50, 20, 80, 10, 30, 70, 90, 25};
+	for(int i = 0; i < 8; ++i)
+		bst.insert(values[i]);
+
+	assert(bst.ordered_find(33) == bst.ordered_end());
+	bstint::const_ordered_iterator it = bst.ordered_find(30);
+	assert(it != bst.ordered_end() && *it == 30);
+	assert(*bst.next(it) == 50 && *bst.prev(it) == 25);
+
+	// ++ e -- proseguono secondo l'ordinamento, non secondo l'inserimento
+	bstint::const_ordered_iterator jt = bst.next(it);
+	++jt;
+	assert(*jt == 70 && *--jt == 50 && *jt-- == 50 && *jt == 30);
+
+	std::cout << "Visita in avanti con next: ";
+	int sorted[] = {10, 20, 25, 30, 50, 70, 80, 90};
+	int i = 0;
+	for(it = bst.ordered_find(10); it != bst.ordered_end(); it = bst.next(it)) {
+		std::cout << *it << " ";
+		assert(*it == sorted[i++]);
+	}
+	std::cout << std::endl;
+	assert(i == 8);
+
+	std::cout << "Visita all'indietro con prev: ";
+	for(it = bst.prev(bst.ordered_end()); it != bst.ordered_end(); it = bst.prev(it)) {
+		std::cout << *it << " ";
+		assert(*it == sorted[--i]);
+	}
+	std::cout << std::endl;
+	assert(i == 0);
+
+	assert(bst.next(bst.ordered_end()) == bst.ordered_end());
+	assert(bst.next(bst.ordered_find(90)) == bst.ordered_end() && bst.prev(bst.ordered_find(10)) == bst.ordered_end());
+
+	// Con la policy multiset l'iteratore conserva il numero di ripetizioni
+	typedef bstree<int, compare_int, void, bstree_multiset_policy> multiint;
+	multiint multi;
+	multi.insert(5);
+	multi.insert(3);
+	multi.insert(5);
+	multiint::const_ordered_iterator m = multi.ordered_find(3);
+	assert(m.count() == 1);
+	m = multi.next(m);
+	assert(*m == 5 && m.count() == 2 && *multi.prev(m) == 3);
+
+	bstree<std::string, compare_string> strings;
+	strings.insert("pulp");
+	strings.insert("fiction");
+	strings.insert("vincent");
+	bstree<std::string, compare_string>::const_ordered_iterator s = strings.ordered_find("fiction");
+	assert(s != strings.ordered_end() && *strings.prev(s) == "pulp" && *strings.next(s) == "vincent");
+	assert(strings.prev(strings.ordered_find("pulp")) == strings.ordered_end());
+	assert(strings.next(strings.ordered_find("vincent")) == strings.ordered_end());
+}
 
 int main() {
     const bstint bst;
@@ -322,6 +1334,22 @@ int main() {
     test_subtree();
     test_string();
     test_point();
+    test_stats();
+    test_rebalance();
+    test_comparator();
+    test_batch();
+    test_insert_bulk();
+    test_map();
+    test_multiset();
+    test_prefix();
+    test_splay();
+    test_bloom();
+    test_sharded();
+    test_parallel();
+    test_static();
+    test_compact();
+    test_kdtree();
+    test_neighbors();
     
     
 	return 0;
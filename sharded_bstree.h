@@ -0,0 +1,540 @@
+#ifndef SHARDED_BSTREE_H
+#define SHARDED_BSTREE_H
+
+#include "bstree.h"
+#include "bstree_parallel.h"
+#include <algorithm>  // std::sort
+#include <atomic>     // std::atomic_load, std::atomic_store
+#include <iterator>   // std::forward_iterator_tag
+#include <memory>     // std::shared_ptr
+#include <mutex>      // std::mutex, std::lock_guard
+#include <vector>     // std::vector
+
+/**
+	@file sharded_bstree.h
+	@brief Dichiarazione della classe templata sharded_bstree
+*/
+
+
+/**
+	Classe che divide lo spazio delle chiavi in K intervalli (shard), ognuno
+	memorizzato in un bstree protetto dal proprio mutex, per permettere inserimenti
+	e ricerche in parallelo su piu' core. I confini degli intervalli vengono scelti
+	da un campione di chiavi e possono essere ricalcolati con rebalance_shards
+	mentre altri thread continuano a lavorare. Dato che gli shard sono intervalli
+	ordinati, la visita in ordine degli shard uno dopo l'altro e' la visita in
+	ordine globale.
+
+	@brief Albero binario di ricerca diviso in intervalli
+
+	@param T tipo del dato
+	@param C funtore di comparazione (< oppure a tre vie) di due dati
+	@param P policy degli alberi (vedi bstree_default_policy)
+*/
+template <typename T, typename C, typename P = bstree_default_policy>
+class sharded_bstree {
+public:
+	typedef bstree<T, C, void, P> tree_type;
+
+private:
+
+	/**
+		Tabella di instradamento immutabile: la versione corrente viene sostituita
+		atomicamente da rebalance_shards.
+	*/
+	struct routing {
+		std::vector<T> bounds; // bounds[i] e' la chiave minima dello shard i+1.
+		unsigned int generation; // Versione della tabella.
+	};
+
+	/**
+		Uno shard: un albero, il suo mutex e la versione della tabella con cui e' stato riempito.
+	*/
+	struct shard {
+		tree_type tree; // Albero dello shard.
+		std::mutex lock; // Mutex che protegge l'albero.
+		unsigned int generation; // Versione della tabella di instradamento.
+
+		shard() : generation(0) {}
+	};
+
+	typedef typename bstree_comparator<T, C>::type compare_type;
+
+	std::vector<shard *> _shards; // Shard, in ordine di chiave.
+	std::shared_ptr<const routing> _routing; // Tabella di instradamento corrente.
+	std::mutex _rebalance_lock; // Serializza le chiamate a rebalance_shards.
+	compare_type _conf; // Comparatore a tre vie.
+	mutable bstree_thread_pool _pool; // Un thread per shard, usato dalle operazioni in lotto.
+
+	sharded_bstree(const sharded_bstree &other) = delete;
+	sharded_bstree &operator=(const sharded_bstree &other) = delete;
+
+	/**
+		Funtore che ordina i dati secondo il comparatore, usato per ordinare il campione.
+	*/
+	struct value_less {
+		const compare_type *conf; // Comparatore.
+
+		bool operator()(const T &a, const T &b) const {
+			return (*conf)(a, b) < 0;
+		}
+	};
+
+	/**
+		Crea k shard vuoti.
+
+		@param k numero di shard (almeno 1)
+	*/
+	void create_shards(unsigned int k) {
+		if(k == 0)
+			k = 1;
+		try {
+			for(unsigned int i = 0; i < k; ++i)
+				_shards.push_back(new shard());
+		}
+		catch(...) {
+			destroy_shards();
+			throw;
+		}
+	}
+
+	/**
+		Dealloca tutti gli shard.
+	*/
+	void destroy_shards() {
+		for(unsigned int i = 0; i < _shards.size(); ++i)
+			delete _shards[i];
+		_shards.clear();
+	}
+
+	/**
+		Costruisce una tabella di instradamento dai quantili di una sequenza ordinata.
+
+		@param sorted dati ordinati
+		@param generation versione della tabella
+	*/
+	std::shared_ptr<const routing> make_routing(const std::vector<T> &sorted, unsigned int generation) const {
+		std::shared_ptr<routing> r(new routing());
+		r->generation = generation;
+		std::size_t n = sorted.size();
+		if(n)
+			for(std::size_t i = 1; i < _shards.size(); ++i)
+				r->bounds.push_back(sorted[i * n / _shards.size()]);
+		return r;
+	}
+
+	/**
+		Determina lo shard che contiene un valore con una ricerca binaria sui confini.
+
+		@param r tabella di instradamento
+		@param value valore
+
+		@return indice dello shard
+	*/
+	unsigned int shard_of(const routing &r, const T &value) const {
+		unsigned int lo = 0;
+		unsigned int hi = r.bounds.size();
+		while(lo < hi) {
+			unsigned int mid = lo + (hi - lo) / 2;
+			if(_conf(value, r.bounds[mid]) < 0)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		return lo;
+	}
+
+	/**
+		Esegue f(i) per ogni shard i elencato sui thread del pool, creati una
+		volta sola dal costruttore (nel thread chiamante se c'e' un solo shard).
+		Se f lancia un'eccezione, le chiamate non ancora iniziate vengono
+		scartate e l'eccezione viene rilanciata dopo la fine di quelle in corso.
+
+		@param ids indici degli shard
+		@param f funzione da eseguire
+	*/
+	template <typename F>
+	void run_parallel(const std::vector<unsigned int> &ids, F f) const {
+		if(ids.size() == 1) {
+			f(ids[0]);
+			return;
+		}
+
+		bstree_thread_pool &pool = _pool;
+		pool.run([&](unsigned int w) {
+			for(std::size_t j = 1; j < ids.size(); ++j) {
+				unsigned int i = ids[j];
+				pool.spawn(w, [&f, i](unsigned int) {
+					f(i);
+				});
+			}
+			f(ids[0]);
+		});
+	}
+
+public:
+
+	/**
+		Costruttore con k shard senza campione: finche' non viene chiamato
+		rebalance_shards tutte le chiavi finiscono nel primo shard.
+
+		@param k numero di shard
+		@throw eccezione di allocazione di memoria
+	*/
+	explicit sharded_bstree(unsigned int k = 1) : _pool(k ? k : 1) {
+		create_shards(k);
+		_routing = make_routing(std::vector<T>(), 0);
+	}
+
+	/**
+		Costruttore con k shard i cui confini sono i quantili di un campione di chiavi.
+
+		@param k numero di shard
+		@param begin iteratore di inizio del campione
+		@param end iteratore di fine del campione
+		@throw eccezione di allocazione di memoria
+	*/
+	template <typename IterT>
+	sharded_bstree(unsigned int k, IterT begin, IterT end) : _pool(k ? k : 1) {
+		create_shards(k);
+		try {
+			std::vector<T> sample;
+			for(; begin != end; ++begin)
+				sample.push_back(static_cast<T>(*begin));
+			value_less less = { &_conf };
+			std::sort(sample.begin(), sample.end(), less);
+			_routing = make_routing(sample, 0);
+		}
+		catch(...) {
+			destroy_shards();
+			throw;
+		}
+	}
+
+	/**
+		Distruttore
+	*/
+	~sharded_bstree() {
+		destroy_shards();
+	}
+
+	/**
+		Ritorna il numero di shard
+
+		@return numero di shard
+	*/
+	unsigned int shards() const {
+		return _shards.size();
+	}
+
+	/**
+		Ritorna il numero di elementi in tutti gli shard
+
+		@return numero di elementi
+	*/
+	unsigned int size() const {
+		unsigned int n = 0;
+		for(unsigned int i = 0; i < _shards.size(); ++i) {
+			std::lock_guard<std::mutex> g(_shards[i]->lock);
+			n += _shards[i]->tree.size();
+		}
+		return n;
+	}
+
+	/**
+		Ritorna il numero di elementi di uno shard
+
+		@param i indice dello shard
+		@return numero di elementi
+	*/
+	unsigned int shard_size(unsigned int i) const {
+		std::lock_guard<std::mutex> g(_shards[i]->lock);
+		return _shards[i]->tree.size();
+	}
+
+	/**
+		Inserisce un elemento nello shard che lo contiene.
+
+		@param value valore da inserire
+		@throw eccezione di allocazione di memoria
+	*/
+	void insert(const T &value) {
+		for(;;) {
+			std::shared_ptr<const routing> r = std::atomic_load(&_routing);
+			shard &s = *_shards[shard_of(*r, value)];
+			std::lock_guard<std::mutex> g(s.lock);
+			if(s.generation != r->generation)
+				continue; // rebalance_shards ha cambiato i confini: instrada di nuovo
+			s.tree.insert(value);
+			return;
+		}
+	}
+
+	/**
+		Determina se esiste un elemento cercandolo nello shard che lo contiene.
+
+		@param value valore da cercare
+
+		@return TRUE se esiste l'elemento
+	*/
+	bool search(const T &value) const {
+		for(;;) {
+			std::shared_ptr<const routing> r = std::atomic_load(&_routing);
+			shard &s = *_shards[shard_of(*r, value)];
+			std::lock_guard<std::mutex> g(s.lock);
+			if(s.generation != r->generation)
+				continue;
+			return s.tree.search(value);
+		}
+	}
+
+	/**
+		Inserisce un lotto di valori: il lotto viene diviso per shard e le parti
+		vengono inserite con insert_bulk in parallelo sui thread del pool. Se
+		l'inserimento in uno shard lancia un'eccezione, quello shard resta
+		invariato, ma le parti degli shard gia' completate restano inserite e
+		quelle non ancora iniziate vengono scartate: il lotto puo' quindi essere
+		inserito solo in parte.
+
+		@param first iteratore di inizio del lotto
+		@param last iteratore di fine del lotto
+		@throw eccezione di allocazione di memoria o di copia dei valori
+	*/
+	template <typename IterT>
+	void insert_batch(IterT first, IterT last) {
+		std::vector<T> pending;
+		for(; first != last; ++first)
+			pending.push_back(static_cast<T>(*first));
+
+		while(!pending.empty()) {
+			std::shared_ptr<const routing> r = std::atomic_load(&_routing);
+			std::vector<std::vector<T> > parts(_shards.size());
+			for(std::size_t i = 0; i < pending.size(); ++i)
+				parts[shard_of(*r, pending[i])].push_back(pending[i]);
+
+			std::vector<unsigned int> ids;
+			for(unsigned int i = 0; i < parts.size(); ++i)
+				if(!parts[i].empty())
+					ids.push_back(i);
+
+			std::vector<char> stale(_shards.size(), 0);
+			run_parallel(ids, [&](unsigned int i) {
+				shard &s = *_shards[i];
+				std::lock_guard<std::mutex> g(s.lock);
+				if(s.generation != r->generation)
+					stale[i] = 1;
+				else
+					s.tree.insert_bulk(parts[i].begin(), parts[i].end());
+			});
+
+			pending.clear();
+			for(unsigned int i = 0; i < parts.size(); ++i)
+				if(stale[i])
+					pending.insert(pending.end(), parts[i].begin(), parts[i].end());
+		}
+	}
+
+	/**
+		Cerca un insieme di valori: le chiavi vengono divise per shard e le parti
+		vengono cercate con search_batch in parallelo sui thread del pool.
+
+		@param keys array dei valori da cercare
+		@param n numero di valori
+		@param out array di n booleani: out[i] e' TRUE se keys[i] esiste
+	*/
+	void search_batch(const T *keys, std::size_t n, bool *out) const {
+		std::vector<std::size_t> pending(n);
+		for(std::size_t i = 0; i < n; ++i)
+			pending[i] = i;
+
+		while(!pending.empty()) {
+			std::shared_ptr<const routing> r = std::atomic_load(&_routing);
+			std::vector<std::vector<std::size_t> > parts(_shards.size());
+			for(std::size_t i = 0; i < pending.size(); ++i)
+				parts[shard_of(*r, keys[pending[i]])].push_back(pending[i]);
+
+			std::vector<unsigned int> ids;
+			for(unsigned int i = 0; i < parts.size(); ++i)
+				if(!parts[i].empty())
+					ids.push_back(i);
+
+			std::vector<char> stale(_shards.size(), 0);
+			run_parallel(ids, [&](unsigned int i) {
+				const std::vector<std::size_t> &idx = parts[i];
+				std::vector<T> k;
+				k.reserve(idx.size());
+				for(std::size_t j = 0; j < idx.size(); ++j)
+					k.push_back(keys[idx[j]]);
+				std::vector<char> found(idx.size());
+
+				shard &s = *_shards[i];
+				{
+					std::lock_guard<std::mutex> g(s.lock);
+					if(s.generation != r->generation) {
+						stale[i] = 1;
+						return;
+					}
+					bool tmp[64];
+					for(std::size_t j = 0; j < k.size(); j += 64) {
+						std::size_t m = std::min<std::size_t>(64, k.size() - j);
+						s.tree.search_batch(&k[j], m, tmp);
+						std::copy(tmp, tmp + m, found.begin() + j);
+					}
+				}
+				for(std::size_t j = 0; j < idx.size(); ++j)
+					out[idx[j]] = found[j];
+			});
+
+			pending.clear();
+			for(unsigned int i = 0; i < parts.size(); ++i)
+				if(stale[i])
+					pending.insert(pending.end(), parts[i].begin(), parts[i].end());
+		}
+	}
+
+	/**
+		Ricalcola i confini degli shard dai quantili delle chiavi presenti e
+		ridistribuisce le chiavi. Gli altri thread possono continuare a usare la
+		struttura: le operazioni in corso vengono completate prima, quelle successive
+		vengono instradate con i nuovi confini. L'ordine d'inserimento all'interno
+		degli shard viene sostituito dall'ordine delle chiavi. I nuovi alberi vengono
+		costruiti a parte e scambiati con quelli degli shard solo alla fine, quindi
+		se viene lanciata un'eccezione la struttura non viene modificata.
+
+		@throw eccezione di allocazione di memoria o di copia dei valori
+	*/
+	void rebalance_shards() {
+		std::lock_guard<std::mutex> rl(_rebalance_lock);
+
+		std::vector<std::unique_lock<std::mutex> > locks;
+		for(unsigned int i = 0; i < _shards.size(); ++i)
+			locks.push_back(std::unique_lock<std::mutex>(_shards[i]->lock));
+
+		std::vector<T> all;
+		std::vector<T> unique;
+		for(unsigned int i = 0; i < _shards.size(); ++i) {
+			const tree_type &t = _shards[i]->tree;
+			for(typename tree_type::const_ordered_iterator it = t.ordered_begin(), ie = t.ordered_end(); it != ie; ++it) {
+				unique.push_back(*it);
+				for(unsigned int c = it.count(); c; --c)
+					all.push_back(*it);
+			}
+		}
+
+		std::shared_ptr<const routing> r = make_routing(unique, _routing->generation + 1);
+
+		std::vector<tree_type> fresh(_shards.size());
+		std::size_t begin = 0;
+		for(unsigned int i = 0; i < _shards.size(); ++i) {
+			std::size_t end = begin;
+			while(end < all.size() && shard_of(*r, all[end]) == i)
+				++end;
+			fresh[i].insert_bulk(all.begin() + begin, all.begin() + end);
+			begin = end;
+		}
+
+		// Da qui nessuna operazione puo' lanciare eccezioni
+		for(unsigned int i = 0; i < _shards.size(); ++i) {
+			_shards[i]->tree.swap(fresh[i]);
+			_shards[i]->generation = r->generation;
+		}
+		std::atomic_store(&_routing, r);
+	}
+
+
+	/**
+		Iteratore costante che visita tutti gli shard in ordine, quindi tutte le
+		chiavi in ordine globale. Non va usato mentre altri thread modificano la struttura.
+
+		@brief Iteratore costante in ordine
+	*/
+	class const_iterator {
+		const sharded_bstree *_sb;
+		unsigned int _shard;
+		typename tree_type::const_ordered_iterator _it;
+
+		// Salta gli shard vuoti, fino alla fine della sequenza
+		void skip_empty() {
+			while(_shard < _sb->_shards.size() && _it == _sb->_shards[_shard]->tree.ordered_end()) {
+				++_shard;
+				if(_shard < _sb->_shards.size())
+					_it = _sb->_shards[_shard]->tree.ordered_begin();
+			}
+		}
+
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+
+		const_iterator() : _sb(nullptr), _shard(0) {
+		}
+
+		// Ritorna il dato riferito dall'iteratore (dereferenziamento)
+		reference operator*() const {
+			return *_it;
+		}
+
+		// Ritorna il puntatore al dato riferito dall'iteratore
+		pointer operator->() const {
+			return &(*_it);
+		}
+
+		const_iterator& operator++() {
+			++_it;
+			skip_empty();
+			return *this;
+		}
+
+		const_iterator operator++(int) {
+			const_iterator tmp(*this);
+			++(*this);
+			return tmp;
+		}
+
+		// Uguaglianza
+		bool operator==(const const_iterator &other) const {
+			return (_shard == other._shard) && (_it == other._it);
+		}
+
+		// Diversita'
+		bool operator!=(const const_iterator &other) const {
+			return !(*this == other);
+		}
+
+	private:
+
+		// Classe container friend per usare il costruttore di inizializzazione.
+		friend class sharded_bstree;
+
+		// Costruttore privato di inizializzazione usato dalla classe container
+		const_iterator(const sharded_bstree *sb, unsigned int shard) : _sb(sb), _shard(shard) {
+			if(_shard < _sb->_shards.size()) {
+				_it = _sb->_shards[_shard]->tree.ordered_begin();
+				skip_empty();
+			}
+		}
+	}; // classe const_iterator
+
+	/**
+		Ritorna l'iteratore alla chiave minima di tutti gli shard
+
+		@return iteratore all'inizio della visita in ordine
+	*/
+	const_iterator begin() const {
+		return const_iterator(this, 0);
+	}
+
+	/**
+		Ritorna l'iteratore alla fine della visita in ordine
+
+		@return iteratore alla fine della visita in ordine
+	*/
+	const_iterator end() const {
+		return const_iterator(this, _shards.size());
+	}
+};
+
+#endif
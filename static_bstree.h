@@ -0,0 +1,187 @@
+#ifndef STATIC_BSTREE_H
+#define STATIC_BSTREE_H
+
+#include <cstddef> // std::size_t
+
+/**
+	@file static_bstree.h
+	@brief Dichiarazione della classe templata static_bstree
+*/
+
+
+/**
+	Array di dimensione fissa usabile nelle funzioni constexpr.
+
+	@brief Array constexpr
+
+	@param T tipo del dato
+	@param N numero di elementi
+*/
+template <typename T, std::size_t N>
+struct static_bstree_array {
+	T v[N > 0 ? N : 1]; // Elementi (almeno uno, per gli insiemi vuoti).
+
+	constexpr T &operator[](std::size_t i) {
+		return v[i];
+	}
+
+	constexpr const T &operator[](std::size_t i) const {
+		return v[i];
+	}
+};
+
+
+/**
+	Classe che implementa un albero binario di ricerca su un insieme di chiavi
+	fisso e noto a tempo di compilazione. Le chiavi vengono ordinate, i duplicati
+	eliminati e l'albero bilanciato disposto in forma implicita in un array
+	(layout di Eytzinger: i figli del nodo k sono 2k e 2k+1) a tempo di
+	compilazione. L'albero e' completato fino a 2^h - 1 nodi ripetendo la chiave
+	massima, cosi' la discesa esegue sempre esattamente h confronti senza salti
+	condizionati ne' allocazioni, e puo' essere valutata anche in una static_assert.
+
+	@brief Albero binario di ricerca costruito a tempo di compilazione
+
+	@param T tipo delle chiavi (intero o enumerazione), confrontate con <
+	@param Keys chiavi, in qualunque ordine
+*/
+template <typename T, T... Keys>
+class static_bstree {
+
+	static constexpr std::size_t _count = sizeof...(Keys); // Numero di chiavi, duplicati compresi.
+
+	/**
+		Ritorna le chiavi ordinate (insertion sort, eseguito dal compilatore).
+
+		@return chiavi ordinate
+	*/
+	static constexpr static_bstree_array<T, _count> sorted_keys() {
+		static_bstree_array<T, _count> a = {{Keys...}};
+		for(std::size_t i = 1; i < _count; ++i) {
+			T x = a[i];
+			std::size_t j = i;
+			for(; j > 0 && x < a[j - 1]; --j)
+				a[j] = a[j - 1];
+			a[j] = x;
+		}
+		return a;
+	}
+
+	/**
+		Ritorna il numero di chiavi distinte.
+
+		@return numero di chiavi distinte
+	*/
+	static constexpr std::size_t unique_count() {
+		static_bstree_array<T, _count> a = sorted_keys();
+		std::size_t n = (_count > 0) ? 1 : 0;
+		for(std::size_t i = 1; i < _count; ++i)
+			if(a[i - 1] < a[i])
+				++n;
+		return n;
+	}
+
+	static constexpr std::size_t _size = unique_count(); // Numero di chiavi distinte.
+
+	/**
+		Ritorna l'altezza dell'albero completo che contiene n chiavi.
+
+		@param n numero di chiavi
+
+		@return altezza
+	*/
+	static constexpr unsigned int height_of(std::size_t n) {
+		unsigned int h = 0;
+		while(((std::size_t(1) << h) - 1) < n)
+			++h;
+		return h;
+	}
+
+	static constexpr unsigned int _height = height_of(_size); // Altezza dell'albero.
+	static constexpr std::size_t _slots = (std::size_t(1) << _height) - 1; // Nodi dell'albero completo.
+
+	/**
+		Riempie in ordine simmetrico il sottoalbero con radice k del layout implicito.
+
+		@param tree array del layout (indici da 1)
+		@param keys chiavi ordinate
+		@param i indice della prossima chiave da usare
+		@param k indice del nodo
+
+		@return indice della prossima chiave da usare
+	*/
+	static constexpr std::size_t fill(static_bstree_array<T, _slots + 1> &tree, const static_bstree_array<T, _slots + 1> &keys, std::size_t i, std::size_t k) {
+		if(k > _slots)
+			return i;
+		i = fill(tree, keys, i, 2 * k);
+		tree[k] = keys[i++];
+		return fill(tree, keys, i, 2 * k + 1);
+	}
+
+	/**
+		Costruisce il layout implicito dell'albero: le chiavi distinte, completate
+		con la chiave massima fino a 2^h - 1, disposte in ordine di Eytzinger.
+
+		@return array del layout (indici da 1, l'elemento 0 non e' usato)
+	*/
+	static constexpr static_bstree_array<T, _slots + 1> layout() {
+		static_bstree_array<T, _count> sorted = sorted_keys();
+		static_bstree_array<T, _slots + 1> keys = {{}};
+		std::size_t n = 0;
+		for(std::size_t i = 0; i < _count; ++i)
+			if(i == 0 || sorted[i - 1] < sorted[i])
+				keys[n++] = sorted[i];
+		for(; n < _slots; ++n)
+			keys[n] = keys[n - 1];
+
+		static_bstree_array<T, _slots + 1> tree = {{}};
+		fill(tree, keys, 0, 1);
+		return tree;
+	}
+
+	static constexpr static_bstree_array<T, _slots + 1> _tree = layout(); // Layout implicito dell'albero.
+
+public:
+
+	/**
+		Ritorna il numero di chiavi distinte
+
+		@return numero di chiavi
+	*/
+	static constexpr std::size_t size() {
+		return _size;
+	}
+
+	/**
+		Ritorna l'altezza dell'albero, cioe' il numero di confronti di una ricerca
+
+		@return altezza dell'albero
+	*/
+	static constexpr unsigned int height() {
+		return _height;
+	}
+
+	/**
+		Determina se esiste una chiave. La discesa esegue sempre height() passi
+		k = 2k + (chiave[k] < value); alla fine il nodo in cui la discesa e' andata
+		a sinistra per l'ultima volta e' la chiave minima >= value.
+
+		@param value valore da cercare
+
+		@return TRUE se esiste la chiave
+	*/
+	static constexpr bool search(const T &value) {
+		std::size_t k = 1;
+		for(unsigned int d = 0; d < _height; ++d)
+			k = 2 * k + (_tree[k] < value);
+		while(k & 1) // risale i passi a destra
+			k >>= 1;
+		k >>= 1; // e l'ultimo a sinistra
+		return k != 0 && !(value < _tree[k]);
+	}
+};
+
+template <typename T, T... Keys>
+constexpr static_bstree_array<T, static_bstree<T, Keys...>::_slots + 1> static_bstree<T, Keys...>::_tree;
+
+#endif